@@ -4,21 +4,26 @@ import sys
 import csv
 import numpy as np
 import matplotlib.pyplot as plt
+import readSMDresults
 
 if len(sys.argv) != 2:
-	print("usage: prog <input csv>")
+	print("usage: prog <input csv or binary results>")
 	exit(1)
 
 input = sys.argv[1]
 
-with open(input) as f:
-    reader = csv.reader(f)
-    header = reader.next()
-    x = []
-    y = []
-    for row in reader:
-        x.append(row[0])
-        y.append(row[1])
+if readSMDresults.isBinary(input):
+    info, x, y, score = readSMDresults.load(input)
+    header = ["start in " + info["path1"], "start in " + info["path2"]]
+else:
+    with open(input) as f:
+        reader = csv.reader(f)
+        header = reader.next()
+        x = []
+        y = []
+        for row in reader:
+            x.append(row[0])
+            y.append(row[1])
 
 plt.scatter(x, y, color='r', s=50, marker='x')
 plt.xlabel(header[0], fontsize=18)
@@ -0,0 +1,146 @@
+#!/usr/bin/env python
+
+# Loads binary result files (swa --binary) into numpy arrays, see src/ResultFile.h for the layout.
+#
+#   import readSMDresults
+#   header, i, j, score = readSMDresults.load("out.swr")
+#   header, i, j, score = readSMDresults.load("out.swr", 1000, 2000)   # rows 1000 <= i < 2000 only
+#
+# Positions are global, header["records1"] and header["records2"] hold the (name, start) pairs to map them to records.
+# If header["bothStrands"] is set, load(..., strands=True) also returns whether each hit is on the reverse complement,
+# whose positions count along it.
+# Run as a script to print a summary.
+
+import struct
+import sys
+import numpy as np
+
+MAGIC = b"SWRESULT"
+VERSION = 1
+
+
+def isBinary(path):
+    with open(path, "rb") as f:
+        return f.read(len(MAGIC)) == MAGIC
+
+
+def _string(f):
+    (n,) = struct.unpack("<I", f.read(4))
+    return f.read(n).decode("utf-8", "replace")
+
+
+def _records(f):
+    (n,) = struct.unpack("<I", f.read(4))
+    records = []
+    for r in range(n):
+        name = _string(f)
+        (start,) = struct.unpack("<Q", f.read(8))
+        records.append((name, start))
+    return records
+
+
+def _header(f):
+    if f.read(len(MAGIC)) != MAGIC:
+        raise ValueError("not a binary result file")
+    version, flags, threshold, _, len1, len2 = struct.unpack("<IIiIQQ", f.read(32))
+    if version != VERSION:
+        raise ValueError("unsupported version %d" % version)
+    header = {
+        "threshold": threshold,
+        "recordOutput": bool(flags & 1),
+        "bothStrands": bool(flags & 2),
+        "len1": len1,
+        "len2": len2,
+        "path1": _string(f),
+        "path2": _string(f),
+    }
+    header["records1"] = _records(f)
+    header["records2"] = _records(f)
+    return header
+
+
+def _blocks(f, blocksStart, size):
+    """Returns the index entries (offset, count, smallest i, largest i), walking the blocks if there is no index."""
+    if size >= blocksStart + 24:
+        f.seek(size - 24)
+        indexOffset, n = struct.unpack("<QQ", f.read(16))
+        if f.read(8) == MAGIC:
+            f.seek(indexOffset)
+            index = np.frombuffer(f.read(32 * n), dtype="<u8").reshape(n, 4)
+            return index
+    # no trailer: walk the blocks
+    blocks = []
+    offset = blocksStart
+    while offset + 8 <= size:
+        f.seek(offset)
+        count, nbytes = struct.unpack("<II", f.read(8))
+        if offset + 8 + nbytes > size:
+            break
+        blocks.append((offset, count, 0, 2 ** 63))
+        offset += 8 + nbytes
+    return np.array(blocks, dtype=np.uint64).reshape(len(blocks), 4)
+
+
+def _decodeVarints(data):
+    b = np.frombuffer(data, dtype=np.uint8)
+    if len(b) == 0:
+        return np.zeros(0, dtype=np.uint64)
+    ends = np.flatnonzero(b < 0x80)
+    starts = np.concatenate(([0], ends[:-1] + 1))
+    shift = (np.arange(len(b)) - np.repeat(starts, ends - starts + 1)) * 7
+    parts = (b & 0x7F).astype(np.uint64) << shift.astype(np.uint64)
+    return np.add.reduceat(parts, starts)
+
+
+def _unzigzag(v):
+    return (v >> np.uint64(1)).astype(np.int64) ^ -(v & np.uint64(1)).astype(np.int64)
+
+
+def load(path, i0=None, i1=None, strands=False):
+    """Returns (header, i, j, score), optionally only for the rows i0 <= i < i1.
+    With strands, a boolean array that marks hits on the reverse strand is appended."""
+    with open(path, "rb") as f:
+        header = _header(f)
+        blocksStart = f.tell()
+        f.seek(0, 2)
+        index = _blocks(f, blocksStart, f.tell())
+
+        parts = []
+        for offset, count, minI, maxI in index:
+            if (i0 is not None and maxI < i0) or (i1 is not None and minI >= i1):
+                continue
+            f.seek(int(offset))
+            count, nbytes = struct.unpack("<II", f.read(8))
+            v = _decodeVarints(f.read(nbytes))[: 3 * count]
+            di = _unzigzag(v[0::3])
+            i = np.cumsum(di)
+            j = np.cumsum(di + _unzigzag(v[1::3]))
+            parts.append((i, j, v[2::3].astype(np.int32)))
+
+    if parts:
+        i = np.concatenate([p[0] for p in parts])
+        j = np.concatenate([p[1] for p in parts])
+        score = np.concatenate([p[2] for p in parts])
+    else:
+        i = j = np.zeros(0, dtype=np.int64)
+        score = np.zeros(0, dtype=np.int32)
+    reverse = np.zeros(len(score), dtype=bool)
+    if header["bothStrands"]:
+        reverse = (score & 1).astype(bool)
+        score = score >> 1
+    keep = np.ones(len(i), dtype=bool)
+    if i0 is not None:
+        keep &= i >= i0
+    if i1 is not None:
+        keep &= i < i1
+    if strands:
+        return header, i[keep], j[keep], score[keep], reverse[keep]
+    return header, i[keep], j[keep], score[keep]
+
+
+if __name__ == "__main__":
+    if len(sys.argv) != 2:
+        print("usage: prog <binary results>")
+        exit(1)
+    header, i, j, score = load(sys.argv[1])
+    print("%s vs %s, threshold %d: %d results" % (header["path1"], header["path2"], header["threshold"], len(i)))
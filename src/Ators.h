@@ -1,17 +1,100 @@
 #ifndef ATORS_H_INCLUDED
 #define ATORS_H_INCLUDED
 
+#include <stdint.h>
+#include <string.h>
 #include <memory>
 #include <queue>
+#include <vector>
 using namespace std;
 
 
-inline uint8_t* persisting_malloc_align (const size_t bytes, const size_t alig)
+/*
+ * An aligned block of memory, owned and freed with the buffer, which can be replaced by a larger block.
+ */
+class AlignedBuffer
 {
-	size_t n = bytes + alig;
-	void* p = new uint8_t [n];
-	align (alig, bytes, p, n);
-	return (uint8_t*) p;
+private:
+	unique_ptr <uint8_t[]> _raw;
+	uint8_t* _data;
+	size_t _capacity;
+
+public:
+	inline AlignedBuffer ()
+		:
+		_raw (),
+		_data (0),
+		_capacity (0)
+	{
+	}
+
+	inline uint8_t* data () const
+	{
+		return _data;
+	}
+
+	/*
+	 * Ensures space for at least the given number of bytes.
+	 * The previous content is lost if the block needs to grow.
+	 */
+	inline void reserve (const size_t bytes, const size_t alig)
+	{
+		if (bytes <= _capacity) {
+			return;
+		}
+		size_t n = bytes + alig;
+		_raw.reset (new uint8_t [n]);
+		void* p = _raw.get ();
+		align (alig, bytes, p, n);
+		_data = (uint8_t*) p;
+		_capacity = bytes;
+	}
+
+	/*
+	 * Same as reserve, but clears the bytes and returns them.
+	 */
+	inline uint8_t* zeroed (const size_t bytes, const size_t alig)
+	{
+		reserve (bytes, alig);
+		memset (_data, 0, bytes);
+		return _data;
+	}
+
+	/*
+	 * Same as reserve, but keeps the first used bytes.
+	 */
+	inline void grow (const size_t bytes, const size_t used, const size_t alig)
+	{
+		if (bytes <= _capacity) {
+			return;
+		}
+		unique_ptr <uint8_t[]> raw (std::move (_raw));
+		uint8_t* const data = _data;
+		_capacity = 0;
+		reserve (bytes, alig);
+		if (used > 0) {
+			memcpy (_data, data, used);
+		}
+	}
+};
+
+
+/*
+ * Moves the content of an array by delta positions towards the front, i.e. index k + delta ends up in k.
+ * Negative values move towards the back. Positions that have no source are cleared.
+ */
+inline void shift_bytes (uint8_t* const p, const size_t len, const int64_t delta)
+{
+	const size_t d = delta > 0 ? delta : -delta;
+	if (d >= len) {
+		memset (p, 0, len);
+	} else if (delta > 0) {
+		memmove (p, p + d, len - d);
+		memset (p + len - d, 0, d);
+	} else if (delta < 0) {
+		memmove (p + d, p, len - d);
+		memset (p, 0, d);
+	}
 }
 
 
@@ -19,6 +102,10 @@ template <class T>
 class IAllocator
 {
 public:
+	virtual ~IAllocator ()
+	{
+	}
+
 	virtual void* alloc () = 0;
 	virtual void free (T* p) = 0;
 };
@@ -38,16 +125,21 @@ public:
 	}
 };
 
+/*
+ * Hands out objects from blocks of 1000, which are only freed with the allocator.
+ */
 template <class T>
 class Allocator_Q : public IAllocator <T>
 {
 private:
 	queue<T*> _Q;
+	vector <AlignedBuffer> _blocks;
 
 public:
 	inline Allocator_Q ()
 		:
-		_Q ()
+		_Q (),
+		_blocks ()
 	{
 	}
 
@@ -55,7 +147,8 @@ public:
 	{
 		if (_Q.empty()) {
 			const int n = 1000;
-			unsigned char* space = persisting_malloc_align (n * sizeof(T), 64);
+			_blocks.push_back (AlignedBuffer ());
+			unsigned char* space = _blocks.back ().zeroed (n * sizeof(T), 64);
 			for (int i = 0; i < n; i++) {
 				unsigned char* p = &( space [i * sizeof(T)] );
 				_Q.push ((T*) p);
@@ -0,0 +1,75 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "Band.h"
+
+
+Band::Band (const int64_t offset, const size_t halfWidth)
+	:
+	_pointI (1, 0),
+	_pointJ (1, offset),
+	HalfWidth (halfWidth)
+{
+}
+
+Band::Band (const char* const path, const size_t halfWidth)
+	:
+	_pointI (),
+	_pointJ (),
+	HalfWidth (halfWidth)
+{
+	ifstream ifs (path);
+	if (!ifs) {
+		cout << "could not open path " << path << endl;
+		exit (7);
+	}
+
+	vector <pair <int64_t, int64_t>> points;
+	for (string line; getline (ifs, line);) {
+		if (line.empty () || line[0] == '#') {
+			continue;
+		}
+		istringstream ss (line);
+		int64_t i, j;
+		if (!(ss >> i >> j) || i < 0) {
+			cout << "invalid band point in " << path << ": " << line << endl;
+			exit (7);
+		}
+		points.push_back (make_pair (i, j));
+	}
+	if (points.empty ()) {
+		cout << "no band points in " << path << endl;
+		exit (7);
+	}
+
+	sort (points.begin (), points.end ());
+	for (auto& p : points) {
+		if (!_pointI.empty () && _pointI.back () == p.first) {
+			continue;
+		}
+		_pointI.push_back (p.first);
+		_pointJ.push_back (p.second);
+	}
+}
+
+int64_t Band::centre (const size_t i) const
+{
+	const int64_t ii = i;
+	auto it = upper_bound (_pointI.begin (), _pointI.end (), ii);
+	if (it == _pointI.begin ()) {
+		return ii - _pointI.front () + _pointJ.front ();
+	}
+	if (it == _pointI.end ()) {
+		return ii - _pointI.back () + _pointJ.back ();
+	}
+
+	size_t k = it - _pointI.begin ();
+	int64_t i0 = _pointI [k - 1];
+	int64_t i1 = _pointI [k];
+	int64_t j0 = _pointJ [k - 1];
+	int64_t j1 = _pointJ [k];
+	return j0 + (j1 - j0) * (ii - i0) / (i1 - i0);
+}
@@ -0,0 +1,49 @@
+#ifndef BAND_H_INCLUDED
+#define BAND_H_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+
+/*
+ * Restricts each row i to the positions j within HalfWidth of a centre line.
+ *
+ * The centre is either i + offset, or a piecewise-linear mapping through a list of (i, j) points read from a file.
+ * Before the first and after the last point, the offset of the nearest point is kept.
+ */
+class Band
+{
+private:
+	vector <int64_t> _pointI;
+	vector <int64_t> _pointJ;
+
+public:
+	const size_t HalfWidth;
+
+	Band (const int64_t offset, const size_t halfWidth);
+
+	/*
+	 * Reads whitespace separated "i j" pairs, one per line. Lines starting with # are ignored.
+	 * Exits the program on invalid input.
+	 */
+	Band (const char* const path, const size_t halfWidth);
+
+	inline size_t width () const
+	{
+		return 2 * HalfWidth + 1;
+	}
+
+	int64_t centre (const size_t i) const;
+
+	/*
+	 * Position j of the first column in the band for row i, may be negative.
+	 */
+	inline int64_t origin (const size_t i) const
+	{
+		return centre (i) - (int64_t) HalfWidth;
+	}
+};
+
+
+#endif // BAND_H_INCLUDED
@@ -0,0 +1,63 @@
+#include <algorithm>
+
+#include "DotPlot.h"
+#include "Options.h"
+
+
+DotPlot::DotPlot (const size_t size, const size_t len1, const size_t len2, const bool count)
+	:
+	_len1 (max ((size_t) 1, len1)),
+	_len2 (max ((size_t) 1, len2)),
+	_rows (min (size, _len1)),
+	_cols (min (size, _len2)),
+	_count (count),
+	_cells ()
+{
+}
+
+void DotPlot::merge (DotPlot& other)
+{
+	if (other._cells.empty ()) {
+		return;
+	}
+	if (_cells.empty ()) {
+		_cells.swap (other._cells);
+		return;
+	}
+	for (size_t k = 0; k < _cells.size (); k++) {
+		const uint16_t v = other._cells [k];
+		_cells [k] = _count ? min (UINT16_MAX, _cells [k] + v) : max (_cells [k], v);
+	}
+	vector <uint16_t> ().swap (other._cells);
+}
+
+void DotPlot::write (ofstream& ofs, const Options& opts) const
+{
+	const uint16_t maxValue = _cells.empty () ? 0 : *max_element (_cells.begin (), _cells.end ());
+	const bool wide = maxValue > 255;
+
+	ofs << "P5\n";
+	ofs << "# dot plot of " << opts.InPath1 << " (rows) against " << opts.InPath2 << " (columns), threshold "
+	    << opts.Threshold << "\n";
+	ofs << "# " << (_count ? "number of hits" : "best score") << " of window pair (i, j) in row i * " << _rows << " / "
+	    << _len1 << ", column j * " << _cols << " / " << _len2 << "\n";
+	if (opts.BothStrands) {
+		ofs << "# hits on the reverse strand are placed at the window of the forward strand with the same bases\n";
+	}
+	ofs << _cols << " " << _rows << "\n" << max ((uint16_t) 1, maxValue) << "\n";
+
+	vector <uint8_t> line (_cols * (wide ? 2 : 1));
+	for (size_t r = 0; r < _rows; r++) {
+		for (size_t c = 0; c < _cols; c++) {
+			const uint16_t v = _cells.empty () ? 0 : _cells [r * _cols + c];
+			if (wide) {
+				// 16 bit samples are big endian
+				line [2 * c] = v >> 8;
+				line [2 * c + 1] = (uint8_t) v;
+			} else {
+				line [c] = (uint8_t) v;
+			}
+		}
+		ofs.write ((const char*) line.data (), line.size ());
+	}
+}
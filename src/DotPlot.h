@@ -0,0 +1,72 @@
+#ifndef DOTPLOT_H_INCLUDED
+#define DOTPLOT_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <fstream>
+#include <vector>
+using namespace std;
+
+class Options;
+
+/*
+ * A downsampled dot plot: window pair (i, j) falls into the bin at row i * rows / len1 and column j * cols / len2,
+ * which keeps the best score or the number of hits there. Counts saturate at 65535.
+ *
+ * Every thread fills a plot of its own, the cells are only allocated with the first hit. merge () adds one into
+ * another and frees it, so memory is bounded by the grid, whatever the number of hits.
+ */
+class DotPlot
+{
+private:
+	const size_t _len1;
+	const size_t _len2;
+	const size_t _rows;
+	const size_t _cols;
+	const bool _count;
+	vector <uint16_t> _cells;
+
+public:
+	/*
+	 * At most size x size bins, but no more rows or columns than there are windows.
+	 */
+	DotPlot (const size_t size, const size_t len1, const size_t len2, const bool count);
+
+	inline bool empty () const
+	{
+		return _cells.empty ();
+	}
+
+	/*
+	 * Hits on the reverse strand count along the reverse complement of gene2, they are placed at the window of the
+	 * forward strand with the same bases, so inversions show up as anti-diagonals.
+	 */
+	inline void add (const size_t i, size_t j, const int score, const bool reverse)
+	{
+		if (_cells.empty ()) {
+			_cells.resize (_rows * _cols);
+		}
+		if (reverse) {
+			j = j + 50 < _len2 ? _len2 - 50 - j : 0;
+		}
+		uint16_t& cell = _cells [i * _rows / _len1 * _cols + j * _cols / _len2];
+		if (_count) {
+			cell += cell < UINT16_MAX;
+		} else if (score > cell) {
+			cell = score;
+		}
+	}
+
+	/*
+	 * Adds the bins of other, which must have the same size, and empties it.
+	 */
+	void merge (DotPlot& other);
+
+	/*
+	 * Writes the bins as a binary PGM image, one pixel per bin and 8 or 16 bits deep as the largest value needs.
+	 * Comments in the header say how windows map to bins.
+	 */
+	void write (ofstream& ofs, const Options& opts) const;
+};
+
+#endif // DOTPLOT_H_INCLUDED
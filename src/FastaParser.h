@@ -0,0 +1,99 @@
+#ifndef FASTAPARSER_H_INCLUDED
+#define FASTAPARSER_H_INCLUDED
+
+#include <string.h>
+#include <string>
+using namespace std;
+
+
+/*
+ * Strips headers and line breaks from FASTA text that arrives in pieces of any size.
+ */
+class FastaParser
+{
+private:
+	bool _lineStart;
+	bool _header;
+	string _headerLine;
+
+	template <class FBases>
+	static inline void emitBases (const char* p, const char* const end, FBases& out)
+	{
+		while (p < end) {
+			const char* cr = (const char*) memchr (p, '\r', end - p);
+			const char* stop = cr ? cr : end;
+			if (stop > p) {
+				out (p, stop - p);
+			}
+			p = cr ? cr + 1 : end;
+		}
+	}
+
+	template <class FHeader>
+	inline void endHeader (FHeader& header)
+	{
+		if (!_headerLine.empty () && _headerLine.back () == '\r') {
+			_headerLine.pop_back ();
+		}
+		header (_headerLine);
+		_headerLine.clear ();
+	}
+
+public:
+	inline FastaParser ()
+		:
+		_lineStart (true),
+		_header (false),
+		_headerLine ()
+	{
+	}
+
+	/*
+	 * Calls bases (p, n) for every run of sequence bytes and header (line) for every header line, without the '>'.
+	 */
+	template <class FBases, class FHeader>
+	inline void feed (const char* p, const char* const end, FBases bases, FHeader header)
+	{
+		while (p < end) {
+			if (_lineStart) {
+				_lineStart = false;
+				_header = *p == '>';
+				if (_header) {
+					p++;
+					continue;
+				}
+			}
+
+			const char* nl = (const char*) memchr (p, '\n', end - p);
+			const char* stop = nl ? nl : end;
+			if (_header) {
+				_headerLine.append (p, stop - p);
+			} else {
+				emitBases (p, stop, bases);
+			}
+			if (!nl) {
+				return;
+			}
+			if (_header) {
+				endHeader (header);
+			}
+			_lineStart = true;
+			_header = false;
+			p = nl + 1;
+		}
+	}
+
+	/*
+	 * Reports a header line that was not terminated by a line break.
+	 */
+	template <class FHeader>
+	inline void finish (FHeader header)
+	{
+		if (_header) {
+			endHeader (header);
+			_header = false;
+		}
+	}
+};
+
+#endif // FASTAPARSER_H_INCLUDED
@@ -63,7 +63,12 @@ public:
 		}
 
 		if (_Next && _Next->_I0 >= i0) {
-			return _Next->skip (i0, i1, ator);
+			FDLL_Node* const p = _Next->skip (i0, i1, ator);
+			if (p->_Next == _Next && p != _Next) {
+				// inserted in front of the next node, which cannot link it itself
+				_Next = p;
+			}
+			return p;
 		}
 
 		void* space = ator.alloc ();
@@ -138,6 +143,38 @@ public:
 
 		return root;
 	}
+
+	/*
+	 * Moves all intervals delta positions towards the front and clips them to [0, len).
+	 */
+	inline static FDLL_Node* shift (FDLL_Node* root, const int delta, const int len, IAllocator<FDLL_Node>& ator)
+	{
+		FDLL_Node* prev = 0;
+		FDLL_Node* p = root;
+
+		while (p) {
+			p->_I0 = max (0, p->_I0 - delta);
+			p->_I1 = min (len - 1, p->_I1 - delta);
+
+			if (p->_I0 <= p->_I1) {
+				prev = p;
+				p = p->_Next;
+				continue;
+			}
+
+			auto cont = p->_Next;
+			if (prev) {
+				prev->_Next = cont;
+			}
+			else {
+				root = cont;
+			}
+			ator.free (p);
+			p = cont;
+		}
+
+		return root;
+	}
 };
 
 /*
@@ -177,7 +214,7 @@ public:
 		}
 
 		_Cursor = _Cursor->skip (j0, j1, _Ator);
-		if (_Cursor && _Cursor < _Root) {
+		if (_Cursor && *_Cursor < *_Root) {
 			_Root = _Cursor;
 		}
 	}
@@ -197,6 +234,12 @@ public:
 	{
 		_Root = FDLL_Node::nextRow (_Root, _Ator);
 	}
+
+	inline void shift (const int delta)
+	{
+		_Root = FDLL_Node::shift (_Root, delta, _len2, _Ator);
+		_Cursor = _Root;
+	}
 };
 
 
@@ -0,0 +1,476 @@
+#include <string.h>
+#include <zlib.h>
+#include <iostream>
+#include <map>
+
+#include "Gzip.h"
+#include "settings.h"
+
+
+/*
+ * Plain file or stdin, the first bytes were already read to detect the format.
+ */
+class FileSource : public ByteSource
+{
+private:
+	FILE* const _file;
+	const vector <char> _prefix;
+	size_t _pos;
+
+public:
+	inline FileSource (FILE* const file, const vector <char>& prefix)
+		:
+		_file (file),
+		_prefix (prefix),
+		_pos (0)
+	{
+	}
+
+	inline ~FileSource ()
+	{
+		if (_file != stdin) {
+			fclose (_file);
+		}
+	}
+
+	inline size_t read (char* const buf, const size_t n)
+	{
+		size_t got = min (n, _prefix.size () - _pos);
+		memcpy (buf, _prefix.data () + _pos, got);
+		_pos += got;
+		return got + fread (buf + got, 1, n - got, _file);
+	}
+};
+
+unique_ptr <ByteSource> openSource (const char* const path, const int nThreads)
+{
+	FILE* file = strcmp (path, "-") == 0 ? stdin : fopen (path, "rb");
+	if (!file) {
+		cout << "could not open path " << path << endl;
+		exit (7);
+	}
+
+	vector <char> prefix (2);
+	prefix.resize (fread (prefix.data (), 1, prefix.size (), file));
+	if (isGzip (prefix.data (), prefix.size ())) {
+		return unique_ptr <ByteSource> (new GzipSource (file, path, prefix, nThreads));
+	}
+	return unique_ptr <ByteSource> (new FileSource (file, prefix));
+}
+
+
+static inline uint16_t u16 (const char* const p)
+{
+	return (uint8_t) p [0] | (uint8_t) p [1] << 8;
+}
+
+static inline uint32_t u32 (const char* const p)
+{
+	return u16 (p) | (uint32_t) u16 (p + 2) << 16;
+}
+
+GzipSource::GzipSource (FILE* const file, const char* const path, const vector <char>& prefix, const int nThreads)
+	:
+	_file (file),
+	_path (path),
+	_pending (prefix),
+	_pendingPos (0),
+	_nThreads (max (1, nThreads)),
+	_lock (),
+	_changed (),
+	_blocks (),
+	_done (false),
+	_abandoned (false),
+	_current (),
+	_pos (0),
+	_worker ()
+{
+	_worker = thread (&GzipSource::decompress, this);
+}
+
+GzipSource::~GzipSource ()
+{
+	{
+		lock_guard <mutex> lock (_lock);
+		_abandoned = true;
+		_changed.notify_all ();
+	}
+	_worker.join ();
+	if (_file != stdin) {
+		fclose (_file);
+	}
+}
+
+void GzipSource::fail (const char* const what)
+{
+	cout << what << " in " << _path << endl;
+	exit (7);
+}
+
+size_t GzipSource::readRaw (char* const buf, const size_t n)
+{
+	size_t got = min (n, _pending.size () - _pendingPos);
+	memcpy (buf, _pending.data () + _pendingPos, got);
+	_pendingPos += got;
+	return got + fread (buf + got, 1, n - got, _file);
+}
+
+/*
+ * Returns false at the end of the file, fails if it ends within the n bytes.
+ */
+bool GzipSource::readExact (char* const buf, const size_t n)
+{
+	const size_t got = readRaw (buf, n);
+	if (got > 0 && got < n) {
+		fail ("truncated gzip data");
+	}
+	return got == n;
+}
+
+/*
+ * Makes sure the first n bytes are available for inspection, if the file is that long.
+ */
+void GzipSource::fillPending (const size_t n)
+{
+	const size_t have = _pending.size ();
+	if (have < n) {
+		_pending.resize (n);
+		_pending.resize (have + fread (_pending.data () + have, 1, n - have, _file));
+	}
+}
+
+/*
+ * Queues a block of output, waiting while the queue is full. Returns false if nobody reads any more.
+ */
+bool GzipSource::emit (vector <char>& block)
+{
+	unique_lock <mutex> lock (_lock);
+	_changed.wait (lock, [this] { return _blocks.size () < GZIP_QUEUE_BLOCKS || _abandoned; });
+	if (_abandoned) {
+		return false;
+	}
+	_blocks.push_back (vector <char> ());
+	_blocks.back ().swap (block);
+	_changed.notify_all ();
+	return true;
+}
+
+void GzipSource::decompress ()
+{
+	/*
+	 * BGZF announces itself in the extra field of the first member: subfield "BC" with 2 bytes of block size.
+	 */
+	fillPending (18);
+	const char* h = _pending.data ();
+	const bool bgzf = _pending.size () >= 18
+		&& (uint8_t) h [2] == 8 && (h [3] & 4) && u16 (h + 10) == 6
+		&& h [12] == 'B' && h [13] == 'C' && u16 (h + 14) == 2;
+
+	if (bgzf) {
+		inflateBgzf ();
+	} else {
+		inflateStream ();
+	}
+
+	lock_guard <mutex> lock (_lock);
+	_done = true;
+	_changed.notify_all ();
+}
+
+void GzipSource::inflateStream ()
+{
+	z_stream zs;
+	memset (&zs, 0, sizeof (zs));
+	if (inflateInit2 (&zs, 15 + 32) != Z_OK) {
+		fail ("could not initialize zlib");
+	}
+
+	vector <char> in (GZIP_BLOCK_BYTES / 4);
+	vector <char> out (GZIP_BLOCK_BYTES);
+	size_t used = 0;
+	bool inMember = false;
+
+	while (true) {
+		if (zs.avail_in == 0) {
+			const size_t got = readRaw (in.data (), in.size ());
+			if (got == 0) {
+				break;
+			}
+			zs.next_in = (Bytef*) in.data ();
+			zs.avail_in = got;
+		}
+
+		zs.next_out = (Bytef*) out.data () + used;
+		zs.avail_out = out.size () - used;
+		const int r = inflate (&zs, Z_NO_FLUSH);
+		used = out.size () - zs.avail_out;
+		if (r == Z_STREAM_END) {
+			// another member may follow
+			inflateReset (&zs);
+			inMember = false;
+		} else if (r == Z_OK) {
+			inMember = true;
+		} else {
+			fail ("invalid gzip data");
+		}
+
+		if (used == out.size ()) {
+			if (!emit (out)) {
+				inflateEnd (&zs);
+				return;
+			}
+			out.resize (GZIP_BLOCK_BYTES);
+			used = 0;
+		}
+	}
+	inflateEnd (&zs);
+
+	if (inMember) {
+		fail ("truncated gzip data");
+	}
+	out.resize (used);
+	if (used > 0) {
+		emit (out);
+	}
+}
+
+/*
+ * Decompresses one complete BGZF block.
+ */
+static bool inflateBlock (const vector <char>& block, vector <char>& out)
+{
+	const size_t xlen = u16 (&block [10]);
+	const size_t n = block.size ();
+	if (n < 12 + xlen + 8) {
+		return false;
+	}
+	const uint32_t crc = u32 (&block [n - 8]);
+	out.resize (u32 (&block [n - 4]));
+
+	z_stream zs;
+	memset (&zs, 0, sizeof (zs));
+	if (inflateInit2 (&zs, -15) != Z_OK) {
+		return false;
+	}
+	zs.next_in = (Bytef*) &block [12 + xlen];
+	zs.avail_in = n - 12 - xlen - 8;
+	// zlib refuses a null output pointer, even for the empty end-of-file block
+	Bytef none;
+	zs.next_out = out.empty () ? &none : (Bytef*) out.data ();
+	zs.avail_out = out.size ();
+	const int r = inflate (&zs, Z_FINISH);
+	const bool ok = r == Z_STREAM_END && zs.total_out == out.size ()
+		&& crc32 (0, (const Bytef*) out.data (), out.size ()) == crc;
+	inflateEnd (&zs);
+	return ok;
+}
+
+/*
+ * Inflates BGZF blocks on threads that run as long as the pool, fed from a queue. Blocks are numbered in the order they
+ * are added, take () returns their output in the same order. Only one thread may add and take.
+ */
+class InflatePool
+{
+private:
+	mutex _lock;
+	condition_variable _queued;
+	condition_variable _inflated;
+	deque <pair <size_t, vector <char>>> _jobs;
+	map <size_t, vector <char>> _done;
+	size_t _added;
+	size_t _taken;
+	bool _failed;
+	bool _closing;
+	vector <thread> _threads;
+
+	void work ()
+	{
+		unique_lock <mutex> lock (_lock);
+		for (;;) {
+			_queued.wait (lock, [this] { return !_jobs.empty () || _closing; });
+			if (_closing) {
+				return;
+			}
+			pair <size_t, vector <char>> job (move (_jobs.front ()));
+			_jobs.pop_front ();
+			lock.unlock ();
+
+			vector <char> out;
+			const bool ok = inflateBlock (job.second, out);
+
+			lock.lock ();
+			_failed |= !ok;
+			_done [job.first].swap (out);
+			_inflated.notify_all ();
+		}
+	}
+
+public:
+	inline InflatePool (const int nThreads)
+		:
+		_lock (),
+		_queued (),
+		_inflated (),
+		_jobs (),
+		_done (),
+		_added (0),
+		_taken (0),
+		_failed (false),
+		_closing (false),
+		_threads ()
+	{
+		for (int t = 0; t < nThreads; t++) {
+			_threads.push_back (thread (&InflatePool::work, this));
+		}
+	}
+
+	/*
+	 * Drops the blocks not inflated yet.
+	 */
+	inline ~InflatePool ()
+	{
+		{
+			lock_guard <mutex> lock (_lock);
+			_closing = true;
+			_queued.notify_all ();
+		}
+		for (auto& t : _threads) {
+			t.join ();
+		}
+	}
+
+	InflatePool (const InflatePool&) = delete;
+	InflatePool& operator = (const InflatePool&) = delete;
+
+	/*
+	 * Blocks added and not taken yet
+	 */
+	inline size_t pending () const
+	{
+		return _added - _taken;
+	}
+
+	inline void add (vector <char>& block)
+	{
+		lock_guard <mutex> lock (_lock);
+		_jobs.push_back (make_pair (_added++, vector <char> ()));
+		_jobs.back ().second.swap (block);
+		_queued.notify_one ();
+	}
+
+	/*
+	 * Waits for the output of the oldest block not taken yet. Returns false if any block turned out to be invalid.
+	 */
+	inline bool take (vector <char>& out)
+	{
+		unique_lock <mutex> lock (_lock);
+		_inflated.wait (lock, [this] { return _failed || _done.count (_taken) > 0; });
+		if (_failed) {
+			return false;
+		}
+		auto d = _done.find (_taken++);
+		out.swap (d->second);
+		_done.erase (d);
+		return true;
+	}
+};
+
+/*
+ * Reads the next compressed BGZF block, returns false at the end of the file.
+ */
+bool GzipSource::readBgzfBlock (vector <char>& block)
+{
+	char h [12];
+	if (!readExact (h, sizeof (h))) {
+		return false;
+	}
+	if ((uint8_t) h [0] != 0x1f || (uint8_t) h [1] != 0x8b || (uint8_t) h [2] != 8 || !(h [3] & 4)) {
+		fail ("invalid BGZF block");
+	}
+	const size_t xlen = u16 (h + 10);
+	block.resize (12 + xlen);
+	memcpy (block.data (), h, sizeof (h));
+	if (!readExact (&block [12], xlen)) {
+		fail ("truncated gzip data");
+	}
+
+	size_t size = 0;
+	for (size_t k = 0; k + 4 <= xlen; k += 4 + u16 (&block [12 + k + 2])) {
+		const char* f = &block [12 + k];
+		if (f [0] == 'B' && f [1] == 'C' && u16 (f + 2) == 2) {
+			size = u16 (f + 4) + 1;
+		}
+	}
+	if (size < block.size () + 8) {
+		fail ("gzip member without BGZF block size");
+	}
+	const size_t have = block.size ();
+	block.resize (size);
+	if (!readExact (&block [have], size - have)) {
+		fail ("truncated gzip data");
+	}
+	return true;
+}
+
+/*
+ * Keeps the pool busy with up to 16 blocks per thread ahead of the output, which is passed on in order, in batches
+ * of about GZIP_BLOCK_BYTES.
+ */
+void GzipSource::inflateBgzf ()
+{
+	InflatePool pool (_nThreads);
+	const size_t ahead = _nThreads * 16;
+	vector <char> block;
+	vector <char> out;
+	vector <char> batch;
+	bool more = true;
+
+	while (more || pool.pending () > 0) {
+		while (more && pool.pending () < ahead) {
+			more = readBgzfBlock (block);
+			if (more) {
+				pool.add (block);
+			}
+		}
+		if (pool.pending () == 0) {
+			break;
+		}
+		if (!pool.take (out)) {
+			fail ("invalid BGZF block");
+		}
+		batch.insert (batch.end (), out.begin (), out.end ());
+		if (batch.size () >= GZIP_BLOCK_BYTES) {
+			if (!emit (batch)) {
+				return;
+			}
+			batch.clear ();
+		}
+	}
+	if (!batch.empty ()) {
+		emit (batch);
+	}
+}
+
+size_t GzipSource::read (char* const buf, const size_t n)
+{
+	size_t got = 0;
+	while (got < n) {
+		if (_pos == _current.size ()) {
+			unique_lock <mutex> lock (_lock);
+			_changed.wait (lock, [this] { return !_blocks.empty () || _done; });
+			if (_blocks.empty ()) {
+				break;
+			}
+			_current.swap (_blocks.front ());
+			_blocks.pop_front ();
+			_pos = 0;
+			_changed.notify_all ();
+			continue;
+		}
+		const size_t k = min (n - got, _current.size () - _pos);
+		memcpy (buf + got, _current.data () + _pos, k);
+		got += k;
+		_pos += k;
+	}
+	return got;
+}
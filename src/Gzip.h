@@ -0,0 +1,93 @@
+#ifndef GZIP_H_INCLUDED
+#define GZIP_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+using namespace std;
+
+
+/*
+ * Sequential input of bytes.
+ */
+class ByteSource
+{
+public:
+	virtual ~ByteSource () {}
+
+	/*
+	 * Fills up to n bytes, returns 0 at the end.
+	 */
+	virtual size_t read (char* const buf, const size_t n) = 0;
+};
+
+/*
+ * Opens a file or stdin ("-"), decompressing it if it starts like a gzip file.
+ * Exits the program if the file cannot be opened.
+ */
+unique_ptr <ByteSource> openSource (const char* const path, const int nThreads);
+
+/*
+ * Returns true if the data starts like a gzip file.
+ */
+inline bool isGzip (const char* const data, const size_t len)
+{
+	return len >= 2 && (uint8_t) data [0] == 0x1f && (uint8_t) data [1] == 0x8b;
+}
+
+
+/*
+ * Decompresses gzip on its own thread, read () takes the output in order.
+ *
+ * BGZF files (a series of gzip members of at most 64 KiB, each announcing its size) are split into their members,
+ * which are queued to a pool of nThreads that decompress them in parallel for as long as the file is read. Any other
+ * gzip file, including concatenated members, is decompressed sequentially. At most GZIP_QUEUE_BLOCKS blocks of
+ * output are kept ahead of the reader.
+ */
+class GzipSource : public ByteSource
+{
+private:
+	FILE* const _file;
+	const char* const _path;
+	vector <char> _pending;
+	size_t _pendingPos;
+	const int _nThreads;
+
+	mutex _lock;
+	condition_variable _changed;
+	deque <vector <char>> _blocks;
+	bool _done;
+	bool _abandoned;
+
+	vector <char> _current;
+	size_t _pos;
+
+	thread _worker;
+
+	size_t readRaw (char* const buf, const size_t n);
+	bool readExact (char* const buf, const size_t n);
+	void fillPending (const size_t n);
+	bool emit (vector <char>& block);
+	void fail (const char* const what);
+
+	void decompress ();
+	void inflateStream ();
+	bool readBgzfBlock (vector <char>& block);
+	void inflateBgzf ();
+
+public:
+	/*
+	 * Takes ownership of the file unless it is stdin. The bytes already read from it are passed in prefix.
+	 */
+	GzipSource (FILE* const file, const char* const path, const vector <char>& prefix, const int nThreads);
+	~GzipSource ();
+
+	size_t read (char* const buf, const size_t n);
+};
+
+#endif // GZIP_H_INCLUDED
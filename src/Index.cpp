@@ -0,0 +1,297 @@
+#include <stdio.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "Index.h"
+#include "Sequence.h"
+#include "Mask.h"
+#include "PackedSequence.h"
+#include "WindowDedup.h"
+
+
+static const char INDEX_MAGIC [8] = { 'S', 'W', 'A', 'I', 'N', 'D', 'E', 'X' };
+static const uint32_t INDEX_BYTE_ORDER = 0x01020304;
+
+enum IndexSection
+{
+	SEC_DATA,
+	SEC_HEADERS,
+	SEC_NAMES,
+	SEC_RECORD_START,
+	SEC_RECORD_END,
+	SEC_MASK_BEGIN,
+	SEC_MASK_END,
+	SEC_PACKED_BITS,
+	SEC_PACKED_CASE,
+	SEC_EX_BEGIN,
+	SEC_EX_END,
+	SEC_EX_OFFSET,
+	SEC_EX_BYTES,
+	SEC_GROUP_SLOT,
+	SEC_GROUP_FIRST,
+	SEC_COUNT
+};
+
+#define INDEX_PACKED 1
+#define INDEX_GROUPS 2
+
+struct IndexHeader
+{
+	char Magic [8];
+	uint32_t Version;
+	uint32_t ByteOrder;
+	uint32_t Flags;
+	uint32_t Reserved;
+	uint64_t Len;
+	uint64_t FileSize;
+	uint64_t MaskNRun;
+	uint64_t PackedTotal;
+	uint64_t Duplicates;
+
+	/*
+	 * Sections in bytes from the start of the file
+	 */
+	uint64_t Offset [SEC_COUNT];
+	uint64_t Size [SEC_COUNT];
+};
+
+/*
+ * Strings are stored one per line.
+ */
+static string joinLines (const vector <string>& lines)
+{
+	string s;
+	for (auto& l : lines) {
+		s += l;
+		s += '\n';
+	}
+	return s;
+}
+
+static vector <string> splitLines (const char* p, const size_t n)
+{
+	vector <string> lines;
+	const char* const end = p + n;
+	while (p < end) {
+		const char* e = (const char*) memchr (p, '\n', end - p);
+		lines.push_back (string (p, e - p));
+		p = e + 1;
+	}
+	return lines;
+}
+
+class IndexWriter
+{
+private:
+	ofstream _ofs;
+	IndexHeader _header;
+
+public:
+	inline IndexWriter (const char* const path)
+		:
+		_ofs (path, ios::binary),
+		_header ()
+	{
+		memcpy (_header.Magic, INDEX_MAGIC, sizeof (INDEX_MAGIC));
+		_header.Version = INDEX_VERSION;
+		_header.ByteOrder = INDEX_BYTE_ORDER;
+		// room for the header, which is written last
+		_ofs.write ((const char*) &_header, sizeof (_header));
+	}
+
+	inline IndexHeader& header ()
+	{
+		return _header;
+	}
+
+	inline void add (const int s, const void* const data, const size_t bytes)
+	{
+		static const char zeros [64] = {};
+		_ofs.write (zeros, (64 - _ofs.tellp () % 64) % 64);
+		_header.Offset [s] = _ofs.tellp ();
+		_header.Size [s] = bytes;
+		_ofs.write ((const char*) data, bytes);
+	}
+
+	template <class T>
+	inline void add (const int s, const vector <T>& v)
+	{
+		add (s, v.data (), v.size () * sizeof (T));
+	}
+
+	/*
+	 * Returns false if anything could not be written.
+	 */
+	inline bool finish ()
+	{
+		_ofs.seekp (0);
+		_ofs.write ((const char*) &_header, sizeof (_header));
+		_ofs.close ();
+		return !_ofs.fail ();
+	}
+};
+
+void ReferenceIndex::write (
+	const char* const path,
+	const Sequence& gene,
+	const WindowMask* const mask,
+	const PackedSequence* const packed,
+	const WindowGroups* const groups,
+	const size_t maskNRun)
+{
+	/*
+	 * Written next to the target and renamed, so searches never map a partial index.
+	 */
+	const string tmp = string (path) + ".tmp";
+	IndexWriter w (tmp.c_str ());
+	IndexHeader& h = w.header ();
+	h.Len = gene.Len;
+	h.FileSize = gene.FileSize;
+	h.MaskNRun = maskNRun;
+
+	w.add (SEC_DATA, gene.Data, gene.Len + 50 + 32);
+	const string headers = joinLines (gene.Headers);
+	const string names = joinLines (gene.Names);
+	w.add (SEC_HEADERS, headers.data (), headers.size ());
+	w.add (SEC_NAMES, names.data (), names.size ());
+	w.add (SEC_RECORD_START, gene.RecordStart);
+	w.add (SEC_RECORD_END, gene.RecordEnd);
+	if (mask) {
+		w.add (SEC_MASK_BEGIN, mask->Begin);
+		w.add (SEC_MASK_END, mask->End);
+	}
+	if (packed) {
+		h.Flags |= INDEX_PACKED;
+		h.PackedTotal = packed->Total;
+		w.add (SEC_PACKED_BITS, packed->Bits, (packed->Total + 3) / 4 + 24);
+		w.add (SEC_PACKED_CASE, packed->Case, packed->Case ? PackedSequence::caseBytes (packed->Total) : 0);
+		w.add (SEC_EX_BEGIN, packed->ExBegin);
+		w.add (SEC_EX_END, packed->ExEnd);
+		w.add (SEC_EX_OFFSET, packed->ExOffset);
+		w.add (SEC_EX_BYTES, packed->ExBytes);
+	}
+	if (groups) {
+		h.Flags |= INDEX_GROUPS;
+		h.Duplicates = groups->Duplicates;
+		w.add (SEC_GROUP_SLOT, groups->Slot, gene.Len * sizeof (uint32_t));
+		w.add (SEC_GROUP_FIRST, groups->First);
+	}
+
+	if (!w.finish () || rename (tmp.c_str (), path) != 0) {
+		cout << "could not write index " << path << endl;
+		exit (7);
+	}
+}
+
+bool ReferenceIndex::isIndex (const char* const path)
+{
+	char magic [sizeof (INDEX_MAGIC)];
+	FILE* f = fopen (path, "rb");
+	if (!f) {
+		return false;
+	}
+	const bool found = fread (magic, 1, sizeof (magic), f) == sizeof (magic)
+		&& memcmp (magic, INDEX_MAGIC, sizeof (magic)) == 0;
+	fclose (f);
+	return found;
+}
+
+ReferenceIndex::ReferenceIndex (const char* const path)
+	:
+	_file (path, MADV_WILLNEED)
+{
+	const IndexHeader* h = (const IndexHeader*) _file.Data;
+	if (_file.Size < sizeof (IndexHeader) || memcmp (h->Magic, INDEX_MAGIC, sizeof (INDEX_MAGIC)) != 0) {
+		cout << "not an index: " << path << endl;
+		exit (7);
+	}
+	if (h->Version != INDEX_VERSION || h->ByteOrder != INDEX_BYTE_ORDER) {
+		cout << "index " << path << " was built by another version or on another platform, please rebuild it" << endl;
+		exit (7);
+	}
+	for (int s = 0; s < SEC_COUNT; s++) {
+		if (h->Offset [s] > _file.Size || h->Size [s] > _file.Size - h->Offset [s]) {
+			cout << "index " << path << " is truncated" << endl;
+			exit (7);
+		}
+	}
+}
+
+template <class T>
+const T* ReferenceIndex::section (const int s, size_t& n) const
+{
+	const IndexHeader* h = (const IndexHeader*) _file.Data;
+	n = h->Size [s] / sizeof (T);
+	return (const T*) (_file.Data + h->Offset [s]);
+}
+
+size_t ReferenceIndex::maskNRun () const
+{
+	return ((const IndexHeader*) _file.Data)->MaskNRun;
+}
+
+unique_ptr <Sequence> ReferenceIndex::sequence () const
+{
+	const IndexHeader* h = (const IndexHeader*) _file.Data;
+	size_t n;
+	unique_ptr <Sequence> seq (new Sequence (section <uint8_t> (SEC_DATA, n), h->Len, h->FileSize));
+	const char* text = section <char> (SEC_HEADERS, n);
+	seq->Headers = splitLines (text, n);
+	text = section <char> (SEC_NAMES, n);
+	seq->Names = splitLines (text, n);
+	const size_t* starts = section <size_t> (SEC_RECORD_START, n);
+	seq->RecordStart.assign (starts, starts + n);
+	const size_t* ends = section <size_t> (SEC_RECORD_END, n);
+	seq->RecordEnd.assign (ends, ends + n);
+	return seq;
+}
+
+unique_ptr <WindowMask> ReferenceIndex::mask () const
+{
+	const IndexHeader* h = (const IndexHeader*) _file.Data;
+	size_t n;
+	const size_t* begin = section <size_t> (SEC_MASK_BEGIN, n);
+	const size_t* end = section <size_t> (SEC_MASK_END, n);
+	if (n == 0) {
+		return unique_ptr <WindowMask> ();
+	}
+	unique_ptr <WindowMask> mask (new WindowMask (h->Len));
+	mask->Begin.assign (begin, begin + n);
+	mask->End.assign (end, end + n);
+	return mask;
+}
+
+unique_ptr <PackedSequence> ReferenceIndex::packed () const
+{
+	const IndexHeader* h = (const IndexHeader*) _file.Data;
+	if (!(h->Flags & INDEX_PACKED)) {
+		return unique_ptr <PackedSequence> ();
+	}
+	size_t n;
+	unique_ptr <PackedSequence> packed (new PackedSequence (section <uint8_t> (SEC_PACKED_BITS, n), h->Len, h->PackedTotal));
+	const uint8_t* lower = section <uint8_t> (SEC_PACKED_CASE, n);
+	packed->Case = n > 0 ? lower : 0;
+	const size_t* p = section <size_t> (SEC_EX_BEGIN, n);
+	packed->ExBegin.assign (p, p + n);
+	p = section <size_t> (SEC_EX_END, n);
+	packed->ExEnd.assign (p, p + n);
+	p = section <size_t> (SEC_EX_OFFSET, n);
+	packed->ExOffset.assign (p, p + n);
+	const uint8_t* bytes = section <uint8_t> (SEC_EX_BYTES, n);
+	packed->ExBytes.assign (bytes, bytes + n);
+	return packed;
+}
+
+unique_ptr <WindowGroups> ReferenceIndex::groups () const
+{
+	const IndexHeader* h = (const IndexHeader*) _file.Data;
+	if (!(h->Flags & INDEX_GROUPS)) {
+		return unique_ptr <WindowGroups> ();
+	}
+	size_t n;
+	const uint32_t* slot = section <uint32_t> (SEC_GROUP_SLOT, n);
+	const size_t* first = section <size_t> (SEC_GROUP_FIRST, n);
+	return unique_ptr <WindowGroups> (new WindowGroups (slot, vector <size_t> (first, first + n), h->Duplicates));
+}
@@ -0,0 +1,69 @@
+#ifndef INDEX_H_INCLUDED
+#define INDEX_H_INCLUDED
+
+#include <stdint.h>
+#include <memory>
+using namespace std;
+
+#include "MappedFile.h"
+
+class Sequence;
+class WindowMask;
+class PackedSequence;
+class WindowGroups;
+
+
+#define INDEX_VERSION 2
+
+/*
+ * A reference (file 2) together with everything derived from it, written by "swa build-index" and memory mapped by
+ * searches instead of parsing the FASTA file again.
+ *
+ * The file starts with an IndexHeader and continues with its sections, each at a multiple of 64 bytes. The sequence
+ * bytes (including the fill behind them), the packed bases and the window slots are used in place, so their pages are
+ * shared by all processes searching the same index. The record table, masked runs and exceptions are small and copied.
+ * Integers are stored in the byte order of the machine that built the index, which is checked when it is opened.
+ */
+class ReferenceIndex
+{
+private:
+	MappedFile _file;
+
+	template <class T>
+	const T* section (const int s, size_t& n) const;
+
+public:
+	/*
+	 * Exits the program if the file is not a valid index of this version.
+	 */
+	ReferenceIndex (const char* const path);
+
+	static bool isIndex (const char* const path);
+
+	/*
+	 * The sequence must have been loaded with fill Sequence::Fill2. mask, packed and groups may be null.
+	 */
+	static void write (
+		const char* const path,
+		const Sequence& gene,
+		const WindowMask* const mask,
+		const PackedSequence* const packed,
+		const WindowGroups* const groups,
+		const size_t maskNRun);
+
+	/*
+	 * The N run length the mask was built with, 0 if none
+	 */
+	size_t maskNRun () const;
+
+	/*
+	 * The returned objects refer to the mapping and must not outlive the index.
+	 * mask () returns null if nothing is masked, packed () and groups () if they were not built into the index.
+	 */
+	unique_ptr <Sequence> sequence () const;
+	unique_ptr <WindowMask> mask () const;
+	unique_ptr <PackedSequence> packed () const;
+	unique_ptr <WindowGroups> groups () const;
+};
+
+#endif // INDEX_H_INCLUDED
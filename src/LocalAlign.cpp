@@ -0,0 +1,449 @@
+/*
+ * Full-length local alignment. A striped pass finds where alignments end, a backward pass from each end finds where
+ * it starts and traces it back, avoiding the pairs of the alignments accepted before.
+ * No alignment crosses the fill between records: cells on a fill byte of either gene score 0 and are never part of
+ * an alignment, so the records on both sides are aligned independently.
+ */
+
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+using namespace std;
+
+#include "LocalAlign.h"
+#include "Ators.h"
+
+#if __AVX2__ && ALLOW_AVX
+#include <immintrin.h>
+#endif
+
+
+static inline int score (const uint8_t a, const uint8_t b)
+{
+	return a == b ? FULL_MATCH : FULL_MISMATCH;
+}
+
+static inline bool isFill (const uint8_t a, const uint8_t b)
+{
+	return a == Sequence::Fill1 || b == Sequence::Fill2;
+}
+
+/*
+ * Collects the ends of alignments column by column. The cells of a column at or above the threshold form runs of
+ * consecutive rows, each run offers its best cell. A run continues the open chain of the column before whose last
+ * row is at most FULL_CHAIN_ROWS above it, otherwise it starts a chain. Once a chain is not continued, its best cell
+ * is appended.
+ */
+class EndChains
+{
+private:
+	struct Chain
+	{
+		AlignmentEnd Peak;
+		size_t LastRow;
+		bool Continued;
+	};
+
+	const int _threshold;
+	vector <AlignmentEnd>& _ends;
+	vector <Chain> _open;
+
+	inline void offer (const size_t j, const size_t row, const int score)
+	{
+		for (auto& c : _open) {
+			if (!c.Continued && row >= c.LastRow && row <= c.LastRow + FULL_CHAIN_ROWS) {
+				if (score > c.Peak.Score) {
+					c.Peak = { score, row, j };
+				}
+				c.LastRow = row;
+				c.Continued = true;
+				return;
+			}
+		}
+		_open.push_back ({ { score, row, j }, row, true });
+	}
+
+public:
+	inline EndChains (const int threshold, vector <AlignmentEnd>& ends)
+		: _threshold (threshold), _ends (ends), _open ()
+	{
+	}
+
+	inline ~EndChains ()
+	{
+		for (auto& c : _open) {
+			_ends.push_back (c.Peak);
+		}
+	}
+
+	/*
+	 * Column j, whose score at row r is cell (r). Only the rows [own, n1) are looked at.
+	 */
+	template <class Cell>
+	inline void column (const size_t j, const size_t own, const size_t n1, Cell cell)
+	{
+		size_t runRow = 0;
+		int runScore = -1;
+		for (size_t r = own; r < n1; r++) {
+			const int h = cell (r);
+			if (h >= _threshold) {
+				if (h > runScore) {
+					runRow = r;
+					runScore = h;
+				}
+			} else if (runScore >= 0) {
+				offer (j, runRow, runScore);
+				runScore = -1;
+			}
+		}
+		if (runScore >= 0) {
+			offer (j, runRow, runScore);
+		}
+
+		size_t kept = 0;
+		for (auto& c : _open) {
+			if (c.Continued) {
+				c.Continued = false;
+				_open [kept++] = c;
+			} else {
+				_ends.push_back (c.Peak);
+			}
+		}
+		_open.resize (kept);
+	}
+
+	/*
+	 * Lets the open chains continue in the next column without looking at this one, none of its cells can reach the
+	 * threshold.
+	 */
+	inline void skip ()
+	{
+		for (auto& c : _open) {
+			_ends.push_back (c.Peak);
+		}
+		_open.clear ();
+	}
+};
+
+#if __AVX2__ && ALLOW_AVX
+
+/*
+ * Moves every 16 bit lane up by one, lane 0 becomes 0.
+ */
+static inline __m256i shiftLanes (const __m256i v)
+{
+	return _mm256_alignr_epi8 (v, _mm256_permute2x128_si256 (v, v, 0x08), 14);
+}
+
+void findAlignmentEnds (
+	const uint8_t* const p1,
+	const size_t n1,
+	const size_t own,
+	const uint8_t* const p2,
+	const size_t n2,
+	const int threshold,
+	vector <AlignmentEnd>& ends)
+{
+	const size_t segLen = (n1 + 15) / 16;
+
+	/*
+	 * Row k * segLen + s is lane k of segment s. Rows past n1 hold a base that never matches and are not owned.
+	 * Fill rows are closed, their cells are kept at 0.
+	 */
+	AlignedBuffer buffer;
+	buffer.reserve (5 * segLen * sizeof (__m256i), 32);
+	__m256i* const query = (__m256i*) buffer.data ();
+	__m256i* const owned = query + segLen;
+	__m256i* const open = owned + segLen;
+	__m256i* load = open + segLen;
+	__m256i* store = load + segLen;
+	for (size_t s = 0; s < segLen; s++) {
+		alignas(32) int16_t q [16];
+		alignas(32) int16_t o [16];
+		alignas(32) int16_t c [16];
+		for (size_t k = 0; k < 16; k++) {
+			const size_t row = k * segLen + s;
+			q [k] = row < n1 ? p1 [row] : -1;
+			o [k] = row >= own && row < n1 ? -1 : 0;
+			c [k] = row < n1 && p1 [row] == Sequence::Fill1 ? 0 : -1;
+		}
+		query [s] = _mm256_load_si256 ((__m256i*) q);
+		owned [s] = _mm256_load_si256 ((__m256i*) o);
+		open [s] = _mm256_load_si256 ((__m256i*) c);
+	}
+
+	const __m256i zero = _mm256_setzero_si256 ();
+	const __m256i gap = _mm256_set1_epi16 (FULL_GAP);
+	const __m256i match = _mm256_set1_epi16 (FULL_MATCH);
+	const __m256i mismatch = _mm256_set1_epi16 (FULL_MISMATCH);
+	for (size_t s = 0; s < segLen; s++) {
+		load [s] = zero;
+	}
+	EndChains chains (threshold, ends);
+
+	for (size_t j = 0; j < n2; j++) {
+		if (p2 [j] == Sequence::Fill2) {
+			for (size_t s = 0; s < segLen; s++) {
+				load [s] = zero;
+			}
+			chains.skip ();
+			continue;
+		}
+		const __m256i t = _mm256_set1_epi16 (p2 [j]);
+		__m256i f = zero;
+		__m256i colMax = zero;
+		__m256i h = shiftLanes (load [segLen - 1]);
+
+		for (size_t s = 0; s < segLen; s++) {
+			h = _mm256_adds_epi16 (h, _mm256_blendv_epi8 (mismatch, match, _mm256_cmpeq_epi16 (query [s], t)));
+			h = _mm256_max_epi16 (h, _mm256_subs_epi16 (load [s], gap));
+			h = _mm256_and_si256 (_mm256_max_epi16 (_mm256_max_epi16 (h, f), zero), open [s]);
+			colMax = _mm256_max_epi16 (colMax, _mm256_and_si256 (h, owned [s]));
+			store [s] = h;
+			f = _mm256_subs_epi16 (h, gap);
+			h = load [s];
+		}
+
+		// gaps along gene1 that cross from one lane into the next
+		f = shiftLanes (f);
+		for (size_t s = 0; _mm256_movemask_epi8 (_mm256_cmpgt_epi16 (f, store [s]));) {
+			store [s] = _mm256_and_si256 (_mm256_max_epi16 (store [s], f), open [s]);
+			colMax = _mm256_max_epi16 (colMax, _mm256_and_si256 (store [s], owned [s]));
+			f = _mm256_subs_epi16 (store [s], gap);
+			if (++s == segLen) {
+				s = 0;
+				f = shiftLanes (f);
+			}
+		}
+
+		__m128i m = _mm_max_epi16 (_mm256_castsi256_si128 (colMax), _mm256_extracti128_si256 (colMax, 1));
+		m = _mm_max_epi16 (m, _mm_srli_si128 (m, 8));
+		m = _mm_max_epi16 (m, _mm_srli_si128 (m, 4));
+		m = _mm_max_epi16 (m, _mm_srli_si128 (m, 2));
+		const int best = _mm_extract_epi16 (m, 0);
+
+		if (best >= threshold) {
+			const int16_t* const cells = (const int16_t*) store;
+			chains.column (j, own, n1, [cells, segLen] (const size_t r) {
+				return cells [(r % segLen) * 16 + r / segLen];
+			});
+		} else {
+			chains.skip ();
+		}
+		swap (load, store);
+	}
+}
+
+#else
+
+void findAlignmentEnds (
+	const uint8_t* const p1,
+	const size_t n1,
+	const size_t own,
+	const uint8_t* const p2,
+	const size_t n2,
+	const int threshold,
+	vector <AlignmentEnd>& ends)
+{
+	vector <int> prev (n1 + 1, 0);
+	vector <int> cur (n1 + 1, 0);
+	EndChains chains (threshold, ends);
+
+	for (size_t j = 0; j < n2; j++) {
+		for (size_t i = 1; i <= n1; i++) {
+			const int diag = prev [i - 1] + score (p1 [i - 1], p2 [j]);
+			cur [i] = isFill (p1 [i - 1], p2 [j]) ? 0 : max (max (0, diag), max (prev [i], cur [i - 1]) - FULL_GAP);
+		}
+		chains.column (j, own, n1, [&cur] (const size_t r) {
+			return cur [r + 1];
+		});
+		prev.swap (cur);
+	}
+}
+
+#endif
+
+static const int DROPPED = INT_MIN / 2;
+
+/*
+ * Score of the backward pass at row p, column q, DROPPED if it was not kept. The origin scores 0.
+ */
+inline int LocalAligner::cell (const size_t p, const size_t q) const
+{
+	if (p == 0) {
+		return q == 0 ? 0 : DROPPED;
+	}
+	if (p >= _lo.size () || q < _lo [p] || q >= _lo [p] + _width [p]) {
+		return DROPPED;
+	}
+	return _cells [_start [p] + q - _lo [p]];
+}
+
+/*
+ * The backward pass aligns gene1 backwards from end.I with gene2 backwards from end.J: cell (p, q) is the best score
+ * of a path from the pair (end.I - p + 1, end.J - q + 1) to the end, whose first step must be the end pair itself.
+ * The best cell is where the alignment starts. Cells falling more than max (FULL_XDROP, end.Score) below the best
+ * score so far are dropped, and each row only spans the columns that its kept neighbours reach.
+ * Along the alignment, a cell scores its total minus the part before the cell, which is positive and less than the
+ * total, so none of its cells is dropped as long as end.Score is not below the total.
+ */
+bool LocalAligner::align (const AlignmentEnd& end, LocalAlignment& out)
+{
+	const size_t i = end.I;
+	const size_t j = end.J;
+	if (used (i, j)) {
+		return false;
+	}
+
+	_cells.clear ();
+	_start.assign (1, 0);
+	_lo.assign (1, 0);
+	_width.assign (1, 1);
+
+	const int xDrop = max (FULL_XDROP, end.Score);
+	int best = DROPPED;
+	size_t bestP = 1;
+	size_t bestQ = 1;
+	for (size_t p = 1; p <= i + 1; p++) {
+		const size_t a = i + 1 - p;
+		const size_t prevLo = _lo [p - 1];
+		const size_t prevEnd = prevLo + _width [p - 1];
+		const size_t start = _cells.size ();
+		size_t lo = p == 1 ? 1 : prevLo;
+		size_t width = 0;
+		int left = DROPPED;
+
+		for (size_t q = lo; q <= j + 1 && (q <= prevEnd || left != DROPPED); q++) {
+			const size_t b = j + 1 - q;
+			int h = DROPPED;
+			if (!isFill (_gene1 [a], _gene2 [b])) {
+				const int diag = cell (p - 1, q - 1);
+				if (diag != DROPPED && !used (a, b)) {
+					h = diag + score (_gene1 [a], _gene2 [b]);
+				}
+				const int up = cell (p - 1, q);
+				if (up != DROPPED) {
+					h = max (h, up - FULL_GAP);
+				}
+				if (left != DROPPED) {
+					h = max (h, left - FULL_GAP);
+				}
+			}
+			if (h != DROPPED && h < best - xDrop) {
+				h = DROPPED;
+			}
+			if (h > best) {
+				best = h;
+				bestP = p;
+				bestQ = q;
+			}
+
+			// leading dropped cells are left out of the row
+			if (h == DROPPED && width == 0) {
+				lo = q + 1;
+			} else {
+				_cells.push_back (h);
+				width++;
+			}
+			left = h;
+		}
+
+		// and so are trailing ones
+		while (width > 0 && _cells.back () == DROPPED) {
+			_cells.pop_back ();
+			width--;
+		}
+		if (width == 0) {
+			break;
+		}
+		_start.push_back (start);
+		_lo.push_back (lo);
+		_width.push_back (width);
+	}
+	if (best == DROPPED) {
+		return false;
+	}
+
+	/*
+	 * Follows the path from the start to the end, preferring pairs, then I, then D as the traceback of windows does.
+	 */
+	_ops.clear ();
+	size_t p = bestP;
+	size_t q = bestQ;
+	while (p > 0 || q > 0) {
+		const int h = cell (p, q);
+		const size_t a = i + 1 - p;
+		const size_t b = j + 1 - q;
+		if (p > 0 && q > 0 && !used (a, b) && cell (p - 1, q - 1) != DROPPED
+		    && cell (p - 1, q - 1) + score (_gene1 [a], _gene2 [b]) == h) {
+			_ops.push_back ('M');
+			p--;
+			q--;
+		} else if (p > 0 && cell (p - 1, q) != DROPPED && cell (p - 1, q) - FULL_GAP == h) {
+			_ops.push_back ('I');
+			p--;
+		} else {
+			_ops.push_back ('D');
+			q--;
+		}
+	}
+
+	out.I0 = i + 1 - bestP;
+	out.I1 = i + 1;
+	out.J0 = j + 1 - bestQ;
+	out.J1 = j + 1;
+	out.Score = best;
+	out.Cigar.clear ();
+	char run [21];
+	for (size_t s = 0; s < _ops.size ();) {
+		size_t n = 1;
+		while (s + n < _ops.size () && _ops [s + n] == _ops [s]) {
+			n++;
+		}
+		char* e = writeDecimal (run, n);
+		*e++ = _ops [s];
+		out.Cigar.append (run, e - run);
+		s += n;
+	}
+	return true;
+}
+
+/*
+ * The alignments hidden by out are found again by scoring its rectangle and FULL_XDROP rows and columns after it
+ * without its pairs, which only changes cells below and to the right of its start.
+ */
+void LocalAligner::accept (const LocalAlignment& out, const int threshold, vector <AlignmentEnd>& ends)
+{
+	size_t a = out.I0;
+	size_t b = out.J0;
+	for (char op : _ops) {
+		if (op == 'M') {
+			_used.insert ((uint64_t) a * (_len2 + 1) + b);
+		}
+		a += op != 'D';
+		b += op != 'I';
+	}
+
+	const size_t n1 = min (out.I1 + FULL_XDROP, _len1) - out.I0;
+	const size_t j1 = min (out.J1 + FULL_XDROP, _len2);
+	vector <int> prev (n1 + 1, 0);
+	vector <int> cur (n1 + 1, 0);
+	vector <AlignmentEnd> found;
+	{
+		EndChains chains (threshold, found);
+		for (size_t j = out.J0; j < j1; j++) {
+			for (size_t r = 1; r <= n1; r++) {
+				const size_t i = out.I0 + r - 1;
+				const int diag = used (i, j) ? 0 : prev [r - 1] + score (_gene1 [i], _gene2 [j]);
+				cur [r] = isFill (_gene1 [i], _gene2 [j]) ? 0 : max (max (0, diag), max (prev [r], cur [r - 1]) - FULL_GAP);
+			}
+			chains.column (j, 0, n1, [&cur] (const size_t r) {
+				return cur [r + 1];
+			});
+			prev.swap (cur);
+		}
+	}
+	for (auto& e : found) {
+		ends.push_back ({ e.Score, out.I0 + e.I, e.J });
+	}
+}
@@ -0,0 +1,168 @@
+#ifndef LOCALALIGN_H_INCLUDED
+#define LOCALALIGN_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string>
+#include <vector>
+#include <unordered_set>
+using namespace std;
+
+#include "settings.h"
+#include "Sequence.h"
+#include "ResultFile.h"
+
+
+/*
+ * Full-length mode: local alignments of any length instead of the scores of fixed windows, scored with FULL_MATCH,
+ * FULL_MISMATCH and a linear gap penalty of FULL_GAP.
+ */
+
+/*
+ * The last aligned pair of an alignment found by findAlignmentEnds (), and the score it reached there
+ */
+struct AlignmentEnd
+{
+	int Score;
+	size_t I;
+	size_t J;
+
+	inline bool operator < (const AlignmentEnd& other) const
+	{
+		if (Score != other.Score) {
+			return Score < other.Score;
+		}
+		return I > other.I || (I == other.I && J > other.J);
+	}
+};
+
+/*
+ * A local alignment of gene1 [I0, I1) with gene2 [J0, J1). In the CIGAR, I consumes a base of gene1 only, D one of
+ * gene2.
+ */
+struct LocalAlignment
+{
+	size_t I0;
+	size_t I1;
+	size_t J0;
+	size_t J1;
+	int Score;
+	string Cigar;
+
+	/*
+	 * Upper bound of the bytes written by write ()
+	 */
+	inline size_t maxLength (const Sequence* const gene1, const Sequence* const gene2) const
+	{
+		size_t n = 5 * 21 + Cigar.size () + 7;
+		if (gene1) {
+			n += 21 + gene1->Names [gene1->findRecord (I0)].size () + gene2->Names [gene2->findRecord (J0)].size () + 2;
+		}
+		return n;
+	}
+
+	/*
+	 * Writes the CSV line to p and returns its end. If the genes are given, positions are written within the records
+	 * the alignment starts in.
+	 */
+	inline char* write (char* p, const Sequence* const gene1, const Sequence* const gene2) const
+	{
+		size_t base1 = 0;
+		size_t base2 = 0;
+		if (gene1) {
+			const size_t r1 = gene1->findRecord (I0);
+			const size_t r2 = gene2->findRecord (J0);
+			base1 = gene1->RecordStart [r1];
+			base2 = gene2->RecordStart [r2];
+			p = writeField (p, gene1->Names [r1]);
+			p = writeNumbers (p, I0 - base1, I1 - base1);
+			p = writeField (p, gene2->Names [r2]);
+			p = writeNumbers (p, J0 - base2, J1 - base2);
+		} else {
+			p = writeNumbers (p, I0, I1);
+			p = writeNumbers (p, J0, J1);
+		}
+		p = writeDecimal (p, Score);
+		*p++ = ',';
+		p = writeField (p, Cigar);
+		*p++ = '\n';
+		return p;
+	}
+
+	inline int hash () const
+	{
+		return (int) (((I0 << 20) | (J0 << 8) | Score) ^ ((I1 - I0) << 12) ^ (J1 - J0));
+	}
+};
+
+/*
+ * Scores the n1 bases of gene1 from p1 on against the n2 bases of gene2 from p2 on, with gene1 in the striped layout
+ * of Farrar (2007) and 16 bit lanes, and appends where alignments of at least threshold end. Of the rows, only those
+ * from own on report ends, the ones before only lead into them.
+ * Every run of cells at or above the threshold within a column offers its best cell. Cells of consecutive columns at
+ * most FULL_CHAIN_ROWS rows apart belong to the same alignment, of which only the best one is appended.
+ * Positions are relative to p1 and p2. Cells on the fill between records score 0, so no alignment spans two records.
+ */
+void findAlignmentEnds (
+	const uint8_t* const p1,
+	const size_t n1,
+	const size_t own,
+	const uint8_t* const p2,
+	const size_t n2,
+	const int threshold,
+	vector <AlignmentEnd>& ends);
+
+/*
+ * Waterman-Eggert: every alignment found shares no aligned pair with the ones accepted before it.
+ */
+class LocalAligner
+{
+private:
+	const uint8_t* const _gene1;
+	const uint8_t* const _gene2;
+	const size_t _len1;
+	const size_t _len2;
+
+	/*
+	 * Aligned pairs of the accepted alignments, as i * (len2 + 1) + j
+	 */
+	unordered_set <uint64_t> _used;
+
+	/*
+	 * Rows of the backward pass: row p covers the columns [Lo [p], Lo [p] + Width [p]) from Start [p] on in _cells.
+	 */
+	vector <int> _cells;
+	vector <size_t> _start;
+	vector <size_t> _lo;
+	vector <size_t> _width;
+	vector <char> _ops;
+
+	inline bool used (const size_t i, const size_t j) const
+	{
+		return !_used.empty () && _used.count ((uint64_t) i * (_len2 + 1) + j);
+	}
+
+	inline int cell (const size_t p, const size_t q) const;
+
+public:
+	inline LocalAligner (const uint8_t* const gene1, const size_t len1, const uint8_t* const gene2, const size_t len2)
+		: _gene1 (gene1), _gene2 (gene2), _len1 (len1), _len2 (len2)
+	{
+	}
+
+	/*
+	 * The best alignment that ends with the pair (end.I, end.J) and shares no pair with the accepted ones.
+	 * end.Score must not be lower than the score of the end, or the alignment may be cut short where its score falls
+	 * by more than that. Returns false if the pair is used.
+	 */
+	bool align (const AlignmentEnd& end, LocalAlignment& out);
+
+	/*
+	 * Marks the pairs of out, which must come from the latest call of align (), as used.
+	 * Alignments that were hidden by it, which end in the cells it covered or shortly after, are appended to ends.
+	 * Their scores only count from its first row and column on.
+	 */
+	void accept (const LocalAlignment& out, const int threshold, vector <AlignmentEnd>& ends);
+};
+
+#endif // LOCALALIGN_H_INCLUDED
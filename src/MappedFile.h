@@ -0,0 +1,59 @@
+#ifndef MAPPEDFILE_H_INCLUDED
+#define MAPPEDFILE_H_INCLUDED
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#include <iostream>
+using namespace std;
+
+
+/*
+ * A read-only mapping of a whole file, unmapped when the object goes away, however that happens.
+ * Read-only mappings of the same file share their pages between processes.
+ */
+class MappedFile
+{
+public:
+	const char* Data;
+	size_t Size;
+
+	inline MappedFile (const char* const path, const int advice = MADV_SEQUENTIAL | MADV_WILLNEED)
+		:
+		Data (0),
+		Size (0)
+	{
+		int fd = open (path, O_RDONLY);
+		struct stat st;
+		if (fd < 0 || fstat (fd, &st) != 0) {
+			cout << "could not open path " << path << endl;
+			exit (7);
+		}
+		Size = st.st_size;
+		if (Size > 0) {
+			void* p = mmap (0, Size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if (p == MAP_FAILED) {
+				cout << "could not map path " << path << endl;
+				exit (7);
+			}
+			madvise (p, Size, advice);
+			Data = (const char*) p;
+		}
+		close (fd);
+	}
+
+	inline ~MappedFile ()
+	{
+		if (Data) {
+			munmap ((void*) Data, Size);
+		}
+	}
+
+	MappedFile (const MappedFile&) = delete;
+	MappedFile& operator = (const MappedFile&) = delete;
+};
+
+#endif // MAPPEDFILE_H_INCLUDED
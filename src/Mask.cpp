@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <iostream>
+
+#include "Mask.h"
+#include "Sequence.h"
+
+
+static const size_t WINDOW = 50;
+
+WindowMask::WindowMask (const size_t len)
+	:
+	_len (len),
+	_excluded (),
+	_included (),
+	_windows (),
+	_hasIncludes (false),
+	Begin (),
+	End ()
+{
+}
+
+void WindowMask::addNRuns (const uint8_t* const data, const size_t minRun)
+{
+	size_t k = 0;
+	while (k < _len) {
+		if (data [k] != 'N' && data [k] != 'n') {
+			k++;
+			continue;
+		}
+		size_t e = k;
+		while (e < _len && (data [e] == 'N' || data [e] == 'n')) {
+			e++;
+		}
+		if (e - k >= minRun) {
+			_excluded.push_back (make_pair (k, e));
+		}
+		k = e;
+	}
+}
+
+void WindowMask::addRecordGaps (const Sequence& gene)
+{
+	for (size_t r = 0; r + 1 < gene.records (); r++) {
+		_windows.push_back (make_pair (gene.RecordEnd [r], gene.RecordStart [r + 1]));
+	}
+}
+
+void WindowMask::addRegions (const char* const path, const bool include, const Sequence& gene, const bool reverse)
+{
+	ifstream ifs (path);
+	if (!ifs) {
+		cout << "could not open path " << path << endl;
+		exit (7);
+	}
+
+	_hasIncludes |= include;
+	for (string line; getline (ifs, line);) {
+		if (line.empty () || line[0] == '#'
+		    || line.compare (0, 5, "track") == 0
+		    || line.compare (0, 7, "browser") == 0) {
+			continue;
+		}
+
+		istringstream ss (line);
+		vector <string> tok;
+		for (string t; ss >> t;) {
+			tok.push_back (t);
+		}
+		size_t first = tok.size () >= 3 ? 1 : 0;
+		char* end0 = 0;
+		char* end1 = 0;
+		long long b = tok.size () >= 2 ? strtoll (tok[first].c_str (), &end0, 10) : -1;
+		long long e = tok.size () >= 2 ? strtoll (tok[first + 1].c_str (), &end1, 10) : -1;
+		if (tok.size () < 2 || *end0 || *end1 || b < 0 || e < b) {
+			cout << "invalid region in " << path << ": " << line << endl;
+			exit (7);
+		}
+
+		size_t recordEnd = gene.Len;
+		if (first > 0 && gene.records () > 1) {
+			size_t r = find (gene.Names.begin (), gene.Names.end (), tok[0]) - gene.Names.begin ();
+			if (r == gene.records ()) {
+				cout << "unknown record " << tok[0] << " in " << path << endl;
+				exit (7);
+			}
+			const size_t len = gene.RecordEnd [r] - gene.RecordStart [r];
+			b = min ((size_t) b, len);
+			e = min ((size_t) e, len);
+			if (!reverse) {
+				b += gene.RecordStart [r];
+				e += gene.RecordStart [r];
+			}
+			recordEnd = gene.RecordEnd [r];
+		}
+		if (reverse) {
+			// the record's forward start is its reverse end
+			const long long rb = recordEnd - min ((size_t) e, recordEnd);
+			e = recordEnd - min ((size_t) b, recordEnd);
+			b = rb;
+		}
+
+		auto& target = include ? _included : _excluded;
+		target.push_back (make_pair ((size_t) b, (size_t) e));
+	}
+}
+
+/*
+ * Sorts and merges overlapping or adjacent runs, clipped to [0, len).
+ */
+static void mergeRuns (vector <pair <size_t, size_t>>& runs, const size_t len)
+{
+	sort (runs.begin (), runs.end ());
+	vector <pair <size_t, size_t>> merged;
+	for (auto r : runs) {
+		r.second = min (r.second, len);
+		if (r.first >= r.second) {
+			continue;
+		}
+		if (!merged.empty () && r.first <= merged.back ().second) {
+			merged.back ().second = max (merged.back ().second, r.second);
+		} else {
+			merged.push_back (r);
+		}
+	}
+	runs.swap (merged);
+}
+
+void WindowMask::finish ()
+{
+	// Excluded bases affect all windows that overlap them.
+	vector <pair <size_t, size_t>> runs;
+	for (auto& r : _excluded) {
+		size_t b = r.first >= WINDOW - 1 ? r.first - (WINDOW - 1) : 0;
+		runs.push_back (make_pair (b, r.second));
+	}
+
+	// Gaps only affect the windows starting in them.
+	runs.insert (runs.end (), _windows.begin (), _windows.end ());
+
+	// Included regions admit the windows starting within them.
+	if (_hasIncludes) {
+		mergeRuns (_included, _len);
+		size_t k = 0;
+		for (auto& r : _included) {
+			runs.push_back (make_pair (k, r.first));
+			k = r.second;
+		}
+		runs.push_back (make_pair (k, _len));
+	}
+
+	mergeRuns (runs, _len);
+	Begin.clear ();
+	End.clear ();
+	for (auto& r : runs) {
+		Begin.push_back (r.first);
+		End.push_back (r.second);
+	}
+}
+
+size_t WindowMask::count () const
+{
+	size_t n = 0;
+	for (size_t r = 0; r < Begin.size (); r++) {
+		n += End [r] - Begin [r];
+	}
+	return n;
+}
+
+size_t WindowMask::findRun (const size_t k) const
+{
+	return upper_bound (End.begin (), End.end (), k) - End.begin ();
+}
+
+bool writeRegions (const char* const path, const vector <pair <size_t, size_t>>& runs, const Sequence& gene)
+{
+	ofstream ofs (path);
+	if (!ofs) {
+		return false;
+	}
+	for (auto& run : runs) {
+		// starts in the gaps between records are left out
+		for (size_t r = gene.findRecord (run.first); r < gene.records () && gene.RecordStart [r] < run.second; r++) {
+			const size_t b = max (run.first, gene.RecordStart [r]);
+			const size_t e = min (run.second, gene.RecordEnd [r]);
+			if (b < e) {
+				ofs << gene.Names [r] << '\t' << b - gene.RecordStart [r] << '\t' << e - gene.RecordStart [r] << '\n';
+			}
+		}
+	}
+	return (bool) ofs;
+}
@@ -0,0 +1,81 @@
+#ifndef MASK_H_INCLUDED
+#define MASK_H_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+class Sequence;
+
+/*
+ * Window starts that are left out of the search, as sorted and disjoint runs [Begin, End).
+ *
+ * A window starting at k covers the bases k .. k + 49. It is masked if any of them lies in an excluded region, if it
+ * starts outside all included regions (when there are any), if it overlaps a long run of N, or if it starts in the
+ * gap between two records.
+ */
+class WindowMask
+{
+private:
+	const size_t _len;
+	vector <pair <size_t, size_t>> _excluded;
+	vector <pair <size_t, size_t>> _included;
+	vector <pair <size_t, size_t>> _windows;
+	bool _hasIncludes;
+
+public:
+	vector <size_t> Begin;
+	vector <size_t> End;
+
+	WindowMask (const size_t len);
+
+	/*
+	 * Excludes every window that overlaps a run of at least minRun N bases.
+	 */
+	void addNRuns (const uint8_t* const data, const size_t minRun);
+
+	/*
+	 * Excludes the windows starting in every gap between two records of gene.
+	 */
+	void addRecordGaps (const Sequence& gene);
+
+	/*
+	 * Reads a BED-style file: "[name] start end" per line, 0-based, end exclusive.
+	 * If gene has several records, name selects the record and the coordinates are relative to it, otherwise the name
+	 * is ignored. Lines starting with #, track or browser are ignored. Exits the program on invalid input.
+	 * If gene is a reverse complement, reverse maps the regions, which are given on the forward strand, onto it.
+	 */
+	void addRegions (const char* const path, const bool include, const Sequence& gene, const bool reverse = false);
+
+	/*
+	 * Merges everything added so far into the runs.
+	 */
+	void finish ();
+
+	inline bool empty () const
+	{
+		return Begin.empty ();
+	}
+
+	size_t count () const;
+
+	/*
+	 * Index of the first run that ends after k.
+	 */
+	size_t findRun (const size_t k) const;
+
+	inline bool isMasked (const size_t k) const
+	{
+		size_t r = findRun (k);
+		return r < Begin.size () && Begin [r] <= k;
+	}
+};
+
+/*
+ * Writes sorted runs [first, second) of window starts as a BED-style file, one line per record they cover, which
+ * addRegions () reads back as included regions. Returns false if the file cannot be written.
+ */
+bool writeRegions (const char* const path, const vector <pair <size_t, size_t>>& runs, const Sequence& gene);
+
+
+#endif // MASK_H_INCLUDED
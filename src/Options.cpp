@@ -0,0 +1,388 @@
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include "Options.h"
+#include "Skipper.h"
+#include "Sequence.h"
+#include "compare.h"
+
+
+Options::Options ()
+	:
+	InPath1 ("data/sox3.fas"),
+	InPath2 ("data/sry.fas"),
+	OutPath ("out.csv"),
+	ThreadCount (4),
+	Threshold (70),
+	Strategy (LOOKUP_STRATEGY),
+	SkipLimit (VERTICAL_SKIP_LIMIT),
+	Dedup (false),
+	BandOffset (0),
+	BandWidth (-1),
+	BandMapPath (0),
+	MaskNRun (0),
+	Exclude1 (0),
+	Exclude2 (0),
+	Include1 (0),
+	Include2 (0),
+	Packed (false),
+	Stream (false),
+	StreamChunkRows (STREAM_CHUNK_ROWS),
+	TileSize (0),
+	Batch (false),
+	BuildIndex (false),
+	Binary (false),
+	ConvertResults (false),
+	Ordered (false),
+	Regions (false),
+	RegionGap (REGION_GAP),
+	TopK (0),
+	AllHits (false),
+	BothStrands (false),
+	Traceback (false),
+	Protein (false),
+	Matrix (PROTEIN_MATRIX),
+	Gap (PROTEIN_GAP),
+	Lanes (false),
+	FullLength (false),
+	DotPlot (false),
+	DotPlotCount (false),
+	DotPlotSize (DOT_PLOT_SIZE),
+	TimeBudget (0)
+{
+}
+
+void Options::printUsage ()
+{
+	cout << "Usage:" << endl;
+	cout << "swa in_path1 in_path2 nThreads threshold out_path [options]" << endl;
+	cout << "swa build-index in_path index_path [nThreads] [--mask-n n] [--exclude2 path] [--include2 path] [--packed] [--dedup]" << endl;
+	cout << "swa to-csv results_path csv_path" << endl;
+	cout << "Starting the program without parameters uses default settings for 4 cores" << endl;
+	cout << endl;
+	cout << "Options:" << endl;
+	cout << "\t--skipper name       memset, dllist, sllist, avxset1, avxset2 or auto (default "
+	     << strategyName (LOOKUP_STRATEGY) << ")" << endl;
+	cout << "\t--skip-limit n|auto  rows below the current one that receive skips (default "
+	     << VERTICAL_SKIP_LIMIT << ")" << endl;
+	cout << "\t--dedup              search identical 50 byte windows only once" << endl;
+	cout << "\t--band-width w       only search j within w of the band centre" << endl;
+	cout << "\t--band-offset d      band centre is i + d (default 0)" << endl;
+	cout << "\t--band-map path      band centre interpolated between \"i j\" points" << endl;
+	cout << "\t--mask-n n           skip windows that overlap runs of at least n N bases" << endl;
+	cout << "\t--exclude1 path      skip windows of file 1 overlapping the regions of a BED file" << endl;
+	cout << "\t--exclude2 path      same for file 2" << endl;
+	cout << "\t--include1 path      only search windows of file 1 starting in the regions of a BED file" << endl;
+	cout << "\t--include2 path      same for file 2" << endl;
+	cout << "\t--packed             store the genes at 2 bits per base" << endl;
+	cout << "\t--stream             read file 1 in chunks while searching, in_path1 - reads stdin" << endl;
+	cout << "\t                     both files must hold a single record" << endl;
+	cout << "\t--chunk-size n       rows per chunk when streaming (default " << STREAM_CHUNK_ROWS << ")" << endl;
+	cout << "\t--tile-size n        read file 2 from disk in tiles of n windows while searching" << endl;
+	cout << "\t                     both files must hold a single record" << endl;
+	cout << "\t--batch              best hit of every row per record of file 2, with record names" << endl;
+	cout << "\t--binary             write compact binary results, see to-csv" << endl;
+	cout << "\t--ordered            write results sorted by row, whatever the number of threads" << endl;
+	cout << "\t--regions            merge hits along a diagonal into regions with their peak" << endl;
+	cout << "\t--region-gap n       rows and diagonals between hits of a region (default " << REGION_GAP << ")" << endl;
+	cout << "\t--top k              only the k best results at or above the threshold, best first" << endl;
+	cout << "\t--all-hits           every window pair at or above the threshold, not just the best per row" << endl;
+	cout << "\t--both-strands       search the reverse complement of file 2 as well, positions on it count along it" << endl;
+	cout << "\t--traceback          add where the alignment starts and ends in both windows and its CIGAR string" << endl;
+	cout << "\t--protein            score amino acids with a substitution matrix" << endl;
+	cout << "\t--matrix name|path   blosum62 or a matrix file in NCBI format, implies --protein (default "
+	     << PROTEIN_MATRIX << ")" << endl;
+	cout << "\t--gap n              gap penalty per position in protein mode (default " << PROTEIN_GAP << ")" << endl;
+	cout << "\t--lanes              score " << COMPARE_LANES << " rows at once, across queries: faster for many short records" << endl;
+	cout << "\t                     of file 1 and at low thresholds, slower where skipping does most of the work" << endl;
+	cout << "\t--full-length        non-overlapping local alignments of any length scoring at least the threshold," << endl;
+	cout << "\t                     best first, instead of windows (match " << FULL_MATCH << ", mismatch " << FULL_MISMATCH
+	     << ", gap " << -FULL_GAP << ")" << endl;
+	cout << "\t--dot-plot max|count  write a PGM image of the best score or the number of hits per bin to out_path," << endl;
+	cout << "\t                     instead of the results" << endl;
+	cout << "\t--dot-plot-size n    bins per side of the dot plot (default " << DOT_PLOT_SIZE << ")" << endl;
+	cout << "\t--time-budget s      stop searching s seconds after the start, with the rows searched so far spread" << endl;
+	cout << "\t                     over file 1. The rows searched and left go to out_path.done.bed and" << endl;
+	cout << "\t                     out_path.todo.bed, give the latter as --include1 to search the rest" << endl;
+	cout << endl;
+}
+
+static const char* requireValue (int argc, char* argv[], int& k)
+{
+	if (k + 1 >= argc) {
+		cout << "missing value for " << argv[k] << endl;
+		exit (2);
+	}
+	return argv[++k];
+}
+
+/*
+ * The index describes file 2, so only the options that derive data from file 2 apply.
+ */
+bool Options::parseBuildIndex (const vector <const char*>& positional)
+{
+	if (positional.size () < 3 || positional.size () > 4) {
+		printUsage ();
+		exit (2);
+	}
+	if (Stream || TileSize > 0 || Batch || Exclude1 || Include1 || BandWidth >= 0 || Protein || Lanes || FullLength) {
+		cout << "only --mask-n, --exclude2, --include2, --packed and --dedup apply to build-index" << endl;
+		exit (2);
+	}
+	BuildIndex = true;
+	InPath2 = positional[1];
+	OutPath = positional[2];
+	if (positional.size () == 4) {
+		ThreadCount = atoi (positional[3]);
+	}
+	return true;
+}
+
+bool Options::parse (int argc, char* argv[])
+{
+	vector <const char*> positional;
+
+	for (int k = 1; k < argc; k++) {
+		const char* arg = argv[k];
+		if (strncmp (arg, "--", 2) != 0) {
+			positional.push_back (arg);
+			continue;
+		}
+
+		if (strcmp (arg, "--skipper") == 0) {
+			const char* name = requireValue (argc, argv, k);
+			Strategy = strategyFromName (name);
+			if (Strategy < 0) {
+				cout << "unknown skipper " << name << endl;
+				exit (2);
+			}
+		} else if (strcmp (arg, "--skip-limit") == 0) {
+			const char* value = requireValue (argc, argv, k);
+			if (strcmp (value, "auto") == 0) {
+				SkipLimit = SKIP_LIMIT_ADAPTIVE;
+			} else {
+				SkipLimit = atoi (value);
+				if (SkipLimit < 0) {
+					cout << "skip limit must not be negative" << endl;
+					exit (2);
+				}
+			}
+		} else if (strcmp (arg, "--dedup") == 0) {
+			Dedup = true;
+		} else if (strcmp (arg, "--band-width") == 0) {
+			BandWidth = atoll (requireValue (argc, argv, k));
+			if (BandWidth < 0) {
+				cout << "band width must not be negative" << endl;
+				exit (2);
+			}
+		} else if (strcmp (arg, "--band-offset") == 0) {
+			BandOffset = atoll (requireValue (argc, argv, k));
+		} else if (strcmp (arg, "--band-map") == 0) {
+			BandMapPath = requireValue (argc, argv, k);
+		} else if (strcmp (arg, "--mask-n") == 0) {
+			long long n = atoll (requireValue (argc, argv, k));
+			MaskNRun = n > 0 ? n : 0;
+		} else if (strcmp (arg, "--exclude1") == 0) {
+			Exclude1 = requireValue (argc, argv, k);
+		} else if (strcmp (arg, "--exclude2") == 0) {
+			Exclude2 = requireValue (argc, argv, k);
+		} else if (strcmp (arg, "--include1") == 0) {
+			Include1 = requireValue (argc, argv, k);
+		} else if (strcmp (arg, "--include2") == 0) {
+			Include2 = requireValue (argc, argv, k);
+		} else if (strcmp (arg, "--packed") == 0) {
+			Packed = true;
+		} else if (strcmp (arg, "--stream") == 0) {
+			Stream = true;
+		} else if (strcmp (arg, "--chunk-size") == 0) {
+			long long n = atoll (requireValue (argc, argv, k));
+			if (n <= 0) {
+				cout << "chunk size must be positive" << endl;
+				exit (2);
+			}
+			StreamChunkRows = n;
+		} else if (strcmp (arg, "--tile-size") == 0) {
+			long long n = atoll (requireValue (argc, argv, k));
+			if (n <= 0) {
+				cout << "tile size must be positive" << endl;
+				exit (2);
+			}
+			TileSize = n;
+		} else if (strcmp (arg, "--batch") == 0) {
+			Batch = true;
+		} else if (strcmp (arg, "--binary") == 0) {
+			Binary = true;
+		} else if (strcmp (arg, "--ordered") == 0) {
+			Ordered = true;
+		} else if (strcmp (arg, "--regions") == 0) {
+			Regions = true;
+		} else if (strcmp (arg, "--region-gap") == 0) {
+			long long n = atoll (requireValue (argc, argv, k));
+			if (n < 1 || n >= (long long) Sequence::RecordGap) {
+				cout << "region gap must be between 1 and " << Sequence::RecordGap - 1 << endl;
+				exit (2);
+			}
+			RegionGap = n;
+		} else if (strcmp (arg, "--top") == 0) {
+			long long n = atoll (requireValue (argc, argv, k));
+			if (n <= 0) {
+				cout << "--top needs a positive number of results" << endl;
+				exit (2);
+			}
+			TopK = n;
+		} else if (strcmp (arg, "--all-hits") == 0) {
+			AllHits = true;
+		} else if (strcmp (arg, "--both-strands") == 0) {
+			BothStrands = true;
+		} else if (strcmp (arg, "--traceback") == 0) {
+			Traceback = true;
+		} else if (strcmp (arg, "--protein") == 0) {
+			Protein = true;
+		} else if (strcmp (arg, "--matrix") == 0) {
+			Matrix = requireValue (argc, argv, k);
+			Protein = true;
+		} else if (strcmp (arg, "--gap") == 0) {
+			Gap = atoi (requireValue (argc, argv, k));
+			if (Gap < 1 || Gap > 32) {
+				cout << "gap penalty must be between 1 and 32" << endl;
+				exit (2);
+			}
+		} else if (strcmp (arg, "--lanes") == 0) {
+			Lanes = true;
+		} else if (strcmp (arg, "--full-length") == 0) {
+			FullLength = true;
+		} else if (strcmp (arg, "--dot-plot") == 0) {
+			const char* mode = requireValue (argc, argv, k);
+			if (strcmp (mode, "max") != 0 && strcmp (mode, "count") != 0) {
+				cout << "--dot-plot takes max or count" << endl;
+				exit (2);
+			}
+			DotPlot = true;
+			DotPlotCount = strcmp (mode, "count") == 0;
+		} else if (strcmp (arg, "--dot-plot-size") == 0) {
+			long long n = atoll (requireValue (argc, argv, k));
+			if (n < 1 || n > DOT_PLOT_MAX_SIZE) {
+				cout << "dot plot size must be between 1 and " << DOT_PLOT_MAX_SIZE << endl;
+				exit (2);
+			}
+			DotPlotSize = n;
+		} else if (strcmp (arg, "--time-budget") == 0) {
+			TimeBudget = atof (requireValue (argc, argv, k));
+			if (TimeBudget <= 0) {
+				cout << "time budget must be a positive number of seconds" << endl;
+				exit (2);
+			}
+		} else {
+			cout << "unknown option " << arg << endl;
+			printUsage ();
+			exit (2);
+		}
+	}
+
+	if (BandWidth < 0 && (BandOffset != 0 || BandMapPath)) {
+		cout << "--band-offset and --band-map require --band-width" << endl;
+		exit (2);
+	}
+
+	if (positional.empty ()) {
+		return false;
+	}
+	if (strcmp (positional[0], "build-index") == 0) {
+		return parseBuildIndex (positional);
+	}
+	if (strcmp (positional[0], "to-csv") == 0) {
+		if (positional.size () != 3) {
+			printUsage ();
+			exit (2);
+		}
+		ConvertResults = true;
+		InPath1 = positional[1];
+		OutPath = positional[2];
+		return true;
+	}
+	if (positional.size () != 5) {
+		printUsage ();
+		exit (2);
+	}
+
+	InPath1 = positional[0];
+	InPath2 = positional[1];
+	ThreadCount = atoi (positional[2]);
+	Threshold = atoi (positional[3]);
+	OutPath = positional[4];
+
+	Stream |= strcmp (InPath1, "-") == 0;
+	if (strcmp (InPath2, "-") == 0) {
+		cout << "only file 1 can be read from stdin" << endl;
+		exit (2);
+	}
+	if (Stream && (Dedup || Packed || Exclude1 || Include1)) {
+		cout << "--dedup, --packed, --exclude1 and --include1 need all of file 1 and cannot be used when streaming" << endl;
+		exit (2);
+	}
+	if (TileSize > 0 && (Stream || Dedup || Packed || Exclude2 || Include2 || BandWidth >= 0)) {
+		cout << "--stream, --dedup, --packed, --exclude2, --include2 and banded mode need all of file 2 "
+		     << "and cannot be used with --tile-size" << endl;
+		exit (2);
+	}
+	if (Batch && (Stream || TileSize > 0 || Dedup)) {
+		cout << "--batch needs the record tables of both files and cannot be used with --stream, --tile-size or --dedup" << endl;
+		exit (2);
+	}
+	if (Regions && (Dedup || Binary)) {
+		cout << "--regions needs the hits in row order and cannot be used with --dedup or --binary" << endl;
+		exit (2);
+	}
+	if (Regions && TopK > 0) {
+		cout << "--regions and --top cannot be combined" << endl;
+		exit (2);
+	}
+	if (AllHits && (Dedup || Regions)) {
+		cout << "--all-hits reports several hits per row and cannot be used with --dedup, which copies one result per row, "
+		     << "or with --regions, which extends a region by one hit per row and would split a match into overlapping ones" << endl;
+		exit (2);
+	}
+	if (BothStrands && (Dedup || TileSize > 0 || BandWidth >= 0)) {
+		cout << "--both-strands cannot be used with --dedup, --tile-size or banded mode" << endl;
+		exit (2);
+	}
+	if (Traceback && (Binary || Regions || Stream || TileSize > 0)) {
+		cout << "--traceback adds CSV columns to single hits and needs all of both files, "
+		     << "it cannot be used with --binary, --regions, --stream or --tile-size" << endl;
+		exit (2);
+	}
+	if (Protein && (Packed || BothStrands || MaskNRun > 0 || Traceback)) {
+		cout << "--packed, --both-strands, --mask-n and --traceback only apply to DNA and cannot be used with --protein" << endl;
+		exit (2);
+	}
+	if (Lanes && (Dedup || BandWidth >= 0 || Packed || Batch || BothStrands || Protein)) {
+		cout << "--lanes cannot be used with --dedup, banded mode, --packed, --batch, --both-strands or --protein" << endl;
+		exit (2);
+	}
+	if (FullLength && (Dedup || BandWidth >= 0 || MaskNRun > 0 || Exclude1 || Exclude2 || Include1 || Include2 || Packed
+	                   || Stream || TileSize > 0 || Batch || Binary || Regions || TopK > 0 || AllHits || BothStrands
+	                   || Traceback || Protein || Lanes)) {
+		cout << "--full-length aligns all of both files and cannot be combined with the options of the window search" << endl;
+		exit (2);
+	}
+	if (DotPlot && (Stream || TileSize > 0 || Binary || Regions || TopK > 0 || Traceback || FullLength)) {
+		cout << "--dot-plot needs the lengths of both files up front and writes an image instead of results, "
+		     << "it cannot be used with --stream, --tile-size, --binary, --regions, --top, --traceback or --full-length" << endl;
+		exit (2);
+	}
+	if (TimeBudget > 0 && (Stream || TileSize > 0 || Dedup || Ordered || FullLength)) {
+		cout << "--time-budget picks the rows of file 1 to search first and cannot be used with --stream, --tile-size, "
+		     << "--dedup, --ordered or --full-length" << endl;
+		exit (2);
+	}
+	if (Ordered && Dedup) {
+		cout << "--dedup reports duplicate rows at the end and cannot be used with --ordered" << endl;
+		exit (2);
+	}
+	if (Ordered && Regions) {
+		cout << "--regions joins the regions at the edges of row blocks at the end and cannot be used with --ordered" << endl;
+		exit (2);
+	}
+	return true;
+}
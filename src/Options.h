@@ -0,0 +1,170 @@
+#ifndef OPTIONS_H_INCLUDED
+#define OPTIONS_H_INCLUDED
+
+#include <stdint.h>
+#include <iostream>
+#include <vector>
+using namespace std;
+
+#include "settings.h"
+
+
+/*
+ * Runtime settings from the command line.
+ *
+ * swa in_path1 in_path2 nThreads threshold out_path [--option value ...]
+ */
+class Options
+{
+private:
+	bool parseBuildIndex (const vector <const char*>& positional);
+
+public:
+	const char* InPath1;
+	const char* InPath2;
+	const char* OutPath;
+	int ThreadCount;
+	int Threshold;
+
+	/*
+	 * One of the STRATEGY_ values, see settings.h
+	 */
+	int Strategy;
+
+	/*
+	 * Vertical skip limit, or SKIP_LIMIT_ADAPTIVE
+	 */
+	int SkipLimit;
+
+	/*
+	 * Search identical windows only once
+	 */
+	bool Dedup;
+
+	/*
+	 * Banded mode is active if BandWidth >= 0.
+	 * The band centre is i + BandOffset, or follows the points in BandMapPath if given.
+	 */
+	int64_t BandOffset;
+	int64_t BandWidth;
+	const char* BandMapPath;
+
+	/*
+	 * Windows overlapping N runs of at least this length are not searched, 0 to disable.
+	 * Region files are BED-style lists of excluded or included regions, null if not given.
+	 */
+	size_t MaskNRun;
+	const char* Exclude1;
+	const char* Exclude2;
+	const char* Include1;
+	const char* Include2;
+
+	/*
+	 * Store both genes at 2 bits per base
+	 */
+	bool Packed;
+
+	/*
+	 * Read gene1 in chunks of StreamChunkRows while searching, implied by the path "-" for stdin
+	 */
+	bool Stream;
+	size_t StreamChunkRows;
+
+	/*
+	 * Read gene2 from disk in tiles of this many windows while searching, 0 to load it completely
+	 */
+	size_t TileSize;
+
+	/*
+	 * Report the best hit of every row for each record of file 2, instead of one per row
+	 */
+	bool Batch;
+
+	/*
+	 * "swa build-index in_path index_path [nThreads]": write an index of InPath2 to OutPath instead of searching.
+	 * An index can be given as in_path2 of later searches.
+	 */
+	bool BuildIndex;
+
+	/*
+	 * Write results in the binary format of ResultFile.h instead of CSV.
+	 * "swa to-csv results_path csv_path" converts such a file (InPath1) to CSV (OutPath) instead of searching.
+	 */
+	bool Binary;
+	bool ConvertResults;
+
+	/*
+	 * Write results sorted by row, the same for any number of threads
+	 */
+	bool Ordered;
+
+	/*
+	 * Write regions of hits along a diagonal instead of single hits, see RegionBuilder
+	 */
+	bool Regions;
+	size_t RegionGap;
+
+	/*
+	 * Only report the TopK best results, best first, 0 to report everything above the threshold
+	 */
+	size_t TopK;
+
+	/*
+	 * Report every window pair at or above the threshold instead of the best one per row
+	 */
+	bool AllHits;
+
+	/*
+	 * Search the reverse complement of file 2 as well, in the same pass
+	 */
+	bool BothStrands;
+
+	/*
+	 * Align the reported window pairs and add their offsets and CIGAR strings to the CSV output
+	 */
+	bool Traceback;
+
+	/*
+	 * Score residues with a substitution matrix (a built-in name or a file) and a linear gap penalty
+	 */
+	bool Protein;
+	const char* Matrix;
+	int Gap;
+
+	/*
+	 * Score COMPARE_LANES consecutive rows of file 1 together, one per byte lane, against each window of file 2
+	 */
+	bool Lanes;
+
+	/*
+	 * Report non-overlapping local alignments of any length instead of window pairs, see LocalAlign.h
+	 */
+	bool FullLength;
+
+	/*
+	 * Write a dot plot of at most DotPlotSize x DotPlotSize bins instead of the results, with the best score or, if
+	 * DotPlotCount is set, the number of hits per bin, see DotPlot.h
+	 */
+	bool DotPlot;
+	bool DotPlotCount;
+	size_t DotPlotSize;
+
+	/*
+	 * Stop searching once this many seconds have passed since the start, 0 for no limit. Rows are searched in blocks
+	 * spread over file 1, the rows searched and left are written next to the results.
+	 */
+	double TimeBudget;
+
+	Options ();
+
+	/*
+	 * Exits the program on invalid input.
+	 * Returns false if no positional parameters were given, i.e. the defaults are used.
+	 */
+	bool parse (int argc, char* argv[]);
+
+	static void printUsage ();
+};
+
+
+#endif // OPTIONS_H_INCLUDED
@@ -0,0 +1,165 @@
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#include "PackedSequence.h"
+
+
+static const uint8_t NO_CODE = 4;
+/*
+ * The bit that makes an ASCII letter lower case, also set in the codes of lower case bases
+ */
+static const uint8_t LOWER = 0x20;
+static const uint8_t BASES [4] = { 'A', 'C', 'G', 'T' };
+
+struct CodeTable
+{
+	uint8_t Code [256];
+
+	inline CodeTable ()
+	{
+		memset (Code, NO_CODE, sizeof (Code));
+		for (uint8_t c = 0; c < 4; c++) {
+			Code [BASES [c]] = c;
+			Code [BASES [c] | LOWER] = c | LOWER;
+		}
+	}
+};
+
+static const CodeTable codeTable;
+
+struct ExceptionRuns
+{
+	vector <size_t> Begin;
+	vector <size_t> End;
+	bool Lower = false;
+};
+
+/*
+ * Packs the bases [k0, k1), k0 must be a multiple of 8, so that no other thread writes the same byte of the bitmap.
+ */
+static void packRange (const uint8_t* const data, const size_t k0, const size_t k1, uint8_t* const bits,
+	uint8_t* const lower, ExceptionRuns& ex)
+{
+	for (size_t k = k0; k < k1; k += 4) {
+		uint8_t b = 0;
+		for (size_t t = 0; t < 4 && k + t < k1; t++) {
+			uint8_t c = codeTable.Code [data [k + t]];
+			if (c & LOWER) {
+				lower [(k + t) >> 3] |= 1 << ((k + t) & 7);
+				ex.Lower = true;
+				c &= 3;
+			} else if (c == NO_CODE) {
+				if (!ex.End.empty () && ex.End.back () == k + t) {
+					ex.End.back ()++;
+				} else {
+					ex.Begin.push_back (k + t);
+					ex.End.push_back (k + t + 1);
+				}
+				c = 0;
+			}
+			b |= c << (2 * t);
+		}
+		bits [k >> 2] = b;
+	}
+}
+
+PackedSequence::PackedSequence (const uint8_t* const data, const size_t len, const size_t total, const int nThreads)
+	:
+	_buffer (),
+	_caseBuffer (),
+	Bits (0),
+	Case (0),
+	Len (len),
+	Total (total),
+	ExBegin (),
+	ExEnd (),
+	ExOffset (),
+	ExBytes ()
+{
+	/*
+	 * 24 extra bytes, so that the compare kernels can load three 64 bit words at any base before Total.
+	 */
+	const size_t nBytes = (total + 3) / 4 + 24;
+	_buffer.reserve (nBytes, 64);
+	uint8_t* const bits = _buffer.data ();
+	memset (bits, 0, nBytes);
+	uint8_t* const lower = _caseBuffer.zeroed (caseBytes (total), 64);
+
+	const int nChunks = max (1, min (nThreads, (int) (total >> 20) + 1));
+	vector <ExceptionRuns> ex (nChunks);
+	vector <thread> threads;
+	for (int c = 0; c < nChunks; c++) {
+		size_t k0 = total * c / nChunks & ~(size_t) 7;
+		size_t k1 = c + 1 == nChunks ? total : total * (c + 1) / nChunks & ~(size_t) 7;
+		threads.push_back (thread (packRange, data, k0, k1, bits, lower, ref (ex [c])));
+	}
+	for (auto& t : threads) {
+		t.join ();
+	}
+
+	if (any_of (ex.begin (), ex.end (), [] (const ExceptionRuns& e) { return e.Lower; })) {
+		Case = lower;
+	} else {
+		_caseBuffer = AlignedBuffer ();
+	}
+
+	// runs may continue across chunk boundaries
+	for (auto& e : ex) {
+		for (size_t r = 0; r < e.Begin.size (); r++) {
+			if (!ExEnd.empty () && ExEnd.back () == e.Begin [r]) {
+				ExEnd.back () = e.End [r];
+			} else {
+				ExBegin.push_back (e.Begin [r]);
+				ExEnd.push_back (e.End [r]);
+			}
+		}
+	}
+	for (size_t r = 0; r < ExBegin.size (); r++) {
+		ExOffset.push_back (ExBytes.size ());
+		ExBytes.insert (ExBytes.end (), data + ExBegin [r], data + ExEnd [r]);
+	}
+
+	Bits = bits;
+}
+
+PackedSequence::PackedSequence (const uint8_t* const bits, const size_t len, const size_t total)
+	:
+	_buffer (),
+	_caseBuffer (),
+	Bits (bits),
+	Case (0),
+	Len (len),
+	Total (total),
+	ExBegin (),
+	ExEnd (),
+	ExOffset (),
+	ExBytes ()
+{
+}
+
+size_t PackedSequence::bytes () const
+{
+	return (Total + 3) / 4 + (Case ? caseBytes (Total) : 0) + ExBytes.size () + ExBegin.size () * 3 * sizeof (size_t);
+}
+
+size_t PackedSequence::findRun (const size_t k) const
+{
+	return upper_bound (ExEnd.begin (), ExEnd.end (), k) - ExEnd.begin ();
+}
+
+void PackedSequence::unpack (const size_t k, const size_t n, uint8_t* const out) const
+{
+	for (size_t d = 0; d < n; d++) {
+		const size_t b = k + d;
+		out [d] = BASES [(Bits [b >> 2] >> (2 * (b & 3))) & 3];
+		if (Case && (Case [b >> 3] >> (b & 7) & 1)) {
+			out [d] |= LOWER;
+		}
+	}
+	for (size_t r = findRun (k); r < ExBegin.size () && ExBegin [r] < k + n; r++) {
+		const size_t b0 = max (ExBegin [r], k);
+		const size_t b1 = min (ExEnd [r], k + n);
+		memcpy (out + (b0 - k), &ExBytes [ExOffset [r] + (b0 - ExBegin [r])], b1 - b0);
+	}
+}
@@ -0,0 +1,95 @@
+#ifndef PACKEDSEQUENCE_H_INCLUDED
+#define PACKEDSEQUENCE_H_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+#include "Ators.h"
+
+
+/*
+ * A sequence stored at 2 bits per base: A = 0, C = 1, G = 2, T = 3.
+ * Base k is found in bits 2 * (k % 4) of byte k / 4, so a little endian load of n bytes holds 4n consecutive bases.
+ * Lower case bases have the code of their upper case one and bit k % 8 of byte k / 8 set in the case bitmap, which
+ * is only kept if there are any. Bases only match if both their codes and their case bits do.
+ *
+ * Every other byte (N, IUPAC codes, the fill after the end) is an exception. Exceptions are kept as sorted runs
+ * together with their original bytes, and their 2 bit code is 0. A window that overlaps an exception has to be
+ * unpacked and compared byte by byte, which gives exactly the results of the unpacked sequence.
+ */
+class PackedSequence
+{
+private:
+	AlignedBuffer _buffer;
+	AlignedBuffer _caseBuffer;
+
+public:
+	const uint8_t* Bits;
+
+	/*
+	 * The case bitmap, readable for 16 bytes past the last base, or null if all bases are upper case
+	 */
+	const uint8_t* Case;
+
+	/*
+	 * Sequence length, and the number of packed bases including the fill behind it
+	 */
+	size_t Len;
+	size_t Total;
+
+	/*
+	 * Exception runs [ExBegin, ExEnd), their bytes start at ExBytes [ExOffset [r]]
+	 */
+	vector <size_t> ExBegin;
+	vector <size_t> ExEnd;
+	vector <size_t> ExOffset;
+	vector <uint8_t> ExBytes;
+
+	/*
+	 * The data must be readable for total bytes, i.e. len bases and the fill behind them.
+	 */
+	PackedSequence (const uint8_t* const data, const size_t len, const size_t total, const int nThreads);
+
+	/*
+	 * A view of packed bases owned by someone else, the case bitmap and the exceptions are filled in by the caller.
+	 */
+	PackedSequence (const uint8_t* const bits, const size_t len, const size_t total);
+
+	PackedSequence (const PackedSequence&) = delete;
+	PackedSequence& operator = (const PackedSequence&) = delete;
+
+	/*
+	 * Bytes of the case bitmap of total bases, including the padding behind it
+	 */
+	static inline size_t caseBytes (const size_t total)
+	{
+		return (total + 7) / 8 + 16;
+	}
+
+	/*
+	 * Memory used by the packed bases, the case bitmap and the exceptions
+	 */
+	size_t bytes () const;
+
+	/*
+	 * Index of the first exception run that ends after k
+	 */
+	size_t findRun (const size_t k) const;
+
+	/*
+	 * Returns true if any base in [k0, k1) is an exception.
+	 */
+	inline bool hasException (const size_t k0, const size_t k1) const
+	{
+		const size_t r = findRun (k0);
+		return r < ExBegin.size () && ExBegin [r] < k1;
+	}
+
+	/*
+	 * Writes the original bytes of [k, k + n) to out, which must hold n bytes.
+	 */
+	void unpack (const size_t k, const size_t n, uint8_t* const out) const;
+};
+
+#endif // PACKEDSEQUENCE_H_INCLUDED
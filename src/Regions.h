@@ -0,0 +1,234 @@
+#ifndef REGIONS_H_INCLUDED
+#define REGIONS_H_INCLUDED
+
+#include <stdint.h>
+#include <algorithm>
+#include <vector>
+using namespace std;
+
+#include "Sequence.h"
+#include "ResultFile.h"
+
+
+/*
+ * Hits along one diagonal, allowing for small gaps between the rows and small shifts of the diagonal.
+ * Rows are window starts in gene1, MinJ and MaxJ the range of window starts in gene2.
+ */
+struct HitRegion
+{
+	size_t I0;
+	size_t I1;
+	size_t MinJ;
+	size_t MaxJ;
+
+	/*
+	 * Columns of the first and the last hit, which give the diagonals other pieces are attached at.
+	 */
+	size_t FirstJ;
+	size_t LastJ;
+
+	size_t PeakI;
+	size_t PeakJ;
+	int PeakScore;
+	size_t Hits;
+
+	/*
+	 * Columns are windows of the reverse complement of gene2
+	 */
+	bool Reverse;
+
+	inline HitRegion (const size_t i, const size_t j, const int score, const bool reverse)
+		:
+		I0 (i), I1 (i), MinJ (j), MaxJ (j), FirstJ (j), LastJ (j),
+		PeakI (i), PeakJ (j), PeakScore (score), Hits (1), Reverse (reverse)
+	{
+	}
+
+	static inline bool startsBefore (const HitRegion& a, const HitRegion& b)
+	{
+		return a.I0 < b.I0 || (a.I0 == b.I0 && a.FirstJ < b.FirstJ);
+	}
+
+	inline int64_t firstDiagonal () const
+	{
+		return (int64_t) FirstJ - (int64_t) I0;
+	}
+
+	inline int64_t lastDiagonal () const
+	{
+		return (int64_t) LastJ - (int64_t) I1;
+	}
+
+	/*
+	 * Appends a region that starts below this one. The earlier peak wins a tie.
+	 */
+	inline void extend (const HitRegion& later)
+	{
+		I1 = later.I1;
+		MinJ = min (MinJ, later.MinJ);
+		MaxJ = max (MaxJ, later.MaxJ);
+		LastJ = later.LastJ;
+		if (later.PeakScore > PeakScore) {
+			PeakI = later.PeakI;
+			PeakJ = later.PeakJ;
+			PeakScore = later.PeakScore;
+		}
+		Hits += later.Hits;
+	}
+
+	/*
+	 * Upper bound of the bytes written by write ()
+	 */
+	inline size_t maxLength (const Sequence* const gene1, const Sequence* const gene2) const
+	{
+		size_t n = 8 * 21 + 2 + 1;
+		if (gene1) {
+			n += gene1->Names [gene1->findRecord (I0)].size () + gene2->Names [gene2->findRecord (MinJ)].size () + 2;
+		}
+		return n;
+	}
+
+	/*
+	 * Writes the CSV line to p and returns its end. If the genes are given, positions are written within the records
+	 * the region starts in. strands adds the strand column.
+	 */
+	inline char* write (char* p, const Sequence* const gene1, const Sequence* const gene2, const bool strands) const
+	{
+		size_t base1 = 0;
+		size_t base2 = 0;
+		if (gene1) {
+			const size_t r1 = gene1->findRecord (I0);
+			const size_t r2 = gene2->findRecord (MinJ);
+			base1 = gene1->RecordStart [r1];
+			base2 = gene2->RecordStart [r2];
+			p = writeField (p, gene1->Names [r1]);
+			p = writeNumbers (p, I0 - base1, I1 - base1);
+			p = writeField (p, gene2->Names [r2]);
+			p = writeNumbers (p, MinJ - base2, MaxJ - base2);
+		} else {
+			p = writeNumbers (p, I0, I1);
+			p = writeNumbers (p, MinJ, MaxJ);
+		}
+		p = writeNumbers (p, PeakI - base1, PeakJ - base2);
+		p = writeNumbers (p, PeakScore, Hits);
+		if (strands) {
+			*p++ = Reverse ? '-' : '+';
+			*p++ = ',';
+		}
+		*p++ = '\n';
+		return p;
+	}
+};
+
+/*
+ * Merges the hits of a range of rows, which must arrive in ascending order of rows, into regions.
+ * A hit or region piece extends the open region of the same strand whose last row is at most _rowGap above it and
+ * whose last diagonal is closest to its first, if within _diagonalGap. Only regions that can still be extended are kept open.
+ *
+ * Regions that might continue in the neighbouring ranges, i.e. start within _rowGap of the range's first row or are
+ * still open at its end, go to Edge and are stitched together once all ranges are done. The others go to Done.
+ */
+class RegionBuilder
+{
+private:
+	const size_t _rowGap;
+	const int64_t _diagonalGap;
+	size_t _i0;
+	size_t _i1;
+	vector <HitRegion> _open;
+
+	inline bool atStart (const HitRegion& r) const
+	{
+		return _i0 > 0 && r.I0 < _i0 + _rowGap;
+	}
+
+	inline void close (const HitRegion& r)
+	{
+		(atStart (r) ? Edge : Done).push_back (r);
+	}
+
+public:
+	vector <HitRegion> Done;
+	vector <HitRegion> Edge;
+
+	inline RegionBuilder (const size_t rowGap, const size_t diagonalGap)
+		:
+		_rowGap (rowGap),
+		_diagonalGap (diagonalGap),
+		_i0 (0),
+		_i1 (-1),
+		_open (),
+		Done (),
+		Edge ()
+	{
+	}
+
+	/*
+	 * Starts the rows [i0, i1). Without a call, the range is unknown and everything open at the end is an edge.
+	 */
+	inline void begin (const size_t i0, const size_t i1)
+	{
+		_i0 = i0;
+		_i1 = i1;
+	}
+
+	inline void add (const HitRegion& piece)
+	{
+		size_t keep = 0;
+		for (auto& r : _open) {
+			if (r.I1 + _rowGap < piece.I0) {
+				close (r);
+			} else {
+				_open [keep++] = r;
+			}
+		}
+		_open.erase (_open.begin () + keep, _open.end ());
+
+		HitRegion* best = 0;
+		int64_t bestDistance = _diagonalGap + 1;
+		for (auto& r : _open) {
+			const int64_t d = abs (piece.firstDiagonal () - r.lastDiagonal ());
+			if (r.I1 < piece.I0 && r.Reverse == piece.Reverse && d < bestDistance) {
+				best = &r;
+				bestDistance = d;
+			}
+		}
+		if (best) {
+			best->extend (piece);
+		} else {
+			_open.push_back (piece);
+		}
+	}
+
+	/*
+	 * Closes the regions at the end of the range.
+	 */
+	inline void finish ()
+	{
+		for (auto& r : _open) {
+			(_i1 == (size_t) -1 || r.I1 + _rowGap >= _i1 || atStart (r) ? Edge : Done).push_back (r);
+		}
+		_open.clear ();
+		_i0 = 0;
+		_i1 = -1;
+	}
+
+	/*
+	 * Joins the edge pieces of all ranges and returns the resulting regions in order of their first rows.
+	 */
+	static inline vector <HitRegion> stitch (vector <HitRegion>& pieces, const size_t rowGap, const size_t diagonalGap)
+	{
+		sort (pieces.begin (), pieces.end (), HitRegion::startsBefore);
+		RegionBuilder b (rowGap, diagonalGap);
+		for (auto& p : pieces) {
+			b.add (p);
+		}
+		b.finish ();
+		vector <HitRegion> regions (b.Done);
+		regions.insert (regions.end (), b.Edge.begin (), b.Edge.end ());
+		sort (regions.begin (), regions.end (), HitRegion::startsBefore);
+		return regions;
+	}
+};
+
+#endif // REGIONS_H_INCLUDED
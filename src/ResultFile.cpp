@@ -0,0 +1,324 @@
+#include <string.h>
+#include <iostream>
+#include <string>
+
+#include "ResultFile.h"
+#include "Results.h"
+
+
+static const char RESULT_MAGIC [8] = { 'S', 'W', 'R', 'E', 'S', 'U', 'L', 'T' };
+
+template <class T>
+static inline void put (ofstream& ofs, const T v)
+{
+	ofs.write ((const char*) &v, sizeof (v));
+}
+
+static inline void putString (ofstream& ofs, const string& s)
+{
+	put (ofs, (uint32_t) s.size ());
+	ofs.write (s.data (), s.size ());
+}
+
+static void putRecords (ofstream& ofs, const Sequence& gene)
+{
+	put (ofs, (uint32_t) gene.records ());
+	for (size_t r = 0; r < gene.records (); r++) {
+		putString (ofs, gene.Names [r]);
+		put (ofs, (uint64_t) gene.RecordStart [r]);
+	}
+}
+
+static void writeRegionHeader (
+	ofstream& ofs,
+	const string& path1,
+	const string& path2,
+	const bool recordOutput,
+	const bool strands)
+{
+	if (recordOutput) {
+		ofs << "record in " << path1 << ",start in record,last start in record,";
+		ofs << "record in " << path2 << ",start in record,last start in record,";
+	} else {
+		ofs << "start in " << path1 << ",last start in " << path1 << ",";
+		ofs << "start in " << path2 << ",last start in " << path2 << ",";
+	}
+	ofs << "peak in " << path1 << ",peak in " << path2 << ",peak score,hits,";
+	if (strands) {
+		ofs << "strand,";
+	}
+	ofs << "\n";
+}
+
+static void writeAlignmentHeader (
+	ofstream& ofs,
+	const string& path1,
+	const string& path2,
+	const bool recordOutput)
+{
+	if (recordOutput) {
+		ofs << "record in " << path1 << ",start in record,end in record,";
+		ofs << "record in " << path2 << ",start in record,end in record,";
+	} else {
+		ofs << "start in " << path1 << ",end in " << path1 << ",";
+		ofs << "start in " << path2 << ",end in " << path2 << ",";
+	}
+	ofs << "score,cigar,\n";
+}
+
+static void writeCsvHeader (
+	ofstream& ofs,
+	const string& path1,
+	const string& path2,
+	const bool recordOutput,
+	const bool strands,
+	const bool traceback)
+{
+	if (recordOutput) {
+		ofs << "record in " << path1 << ",start in record,";
+		ofs << "record in " << path2 << ",start in record,";
+	} else {
+		ofs << "start in " << path1 << ",";
+		ofs << "start in " << path2 << ",";
+	}
+	ofs << "score" << ",";
+	if (strands) {
+		ofs << "strand,";
+	}
+	if (traceback) {
+		ofs << "start in window 1,end in window 1,start in window 2,end in window 2,cigar,";
+	}
+	ofs << "\n";
+}
+
+void writeResultHeader (
+	ofstream& ofs,
+	const Options& opts,
+	const Sequence& gene1,
+	const Sequence& gene2,
+	const bool recordOutput)
+{
+	if (opts.DotPlot) {
+		// the image header needs the largest value, it is written with the plot
+		return;
+	}
+	if (opts.FullLength) {
+		writeAlignmentHeader (ofs, opts.InPath1, opts.InPath2, recordOutput);
+		return;
+	}
+	if (opts.Regions) {
+		writeRegionHeader (ofs, opts.InPath1, opts.InPath2, recordOutput, opts.BothStrands);
+		return;
+	}
+	if (!opts.Binary) {
+		writeCsvHeader (ofs, opts.InPath1, opts.InPath2, recordOutput, opts.BothStrands, opts.Traceback);
+		return;
+	}
+	ofs.write (RESULT_MAGIC, sizeof (RESULT_MAGIC));
+	put (ofs, (uint32_t) RESULT_FILE_VERSION);
+	put (ofs, (uint32_t) ((recordOutput ? RESULT_FILE_RECORDS : 0) | (opts.BothStrands ? RESULT_FILE_STRANDS : 0)));
+	put (ofs, (int32_t) opts.Threshold);
+	put (ofs, (uint32_t) 0);
+	put (ofs, (uint64_t) gene1.Len);
+	put (ofs, (uint64_t) gene2.Len);
+	putString (ofs, opts.InPath1);
+	putString (ofs, opts.InPath2);
+	putRecords (ofs, gene1);
+	putRecords (ofs, gene2);
+}
+
+void writeResultIndex (ofstream& ofs, const vector <ResultIndexEntry>& index)
+{
+	const uint64_t offset = ofs.tellp ();
+	ofs.write ((const char*) index.data (), index.size () * sizeof (ResultIndexEntry));
+	put (ofs, offset);
+	put (ofs, (uint64_t) index.size ());
+	ofs.write (RESULT_MAGIC, sizeof (RESULT_MAGIC));
+}
+
+/*
+ * Reads a binary result file, exits the program on invalid input.
+ */
+class ResultReader
+{
+private:
+	const char* const _path;
+	ifstream _ifs;
+
+	inline void fail (const char* const what)
+	{
+		cout << what << " in " << _path << endl;
+		exit (7);
+	}
+
+public:
+	inline ResultReader (const char* const path)
+		:
+		_path (path),
+		_ifs (path, ios::binary)
+	{
+		if (!_ifs) {
+			cout << "could not open path " << path << endl;
+			exit (7);
+		}
+	}
+
+	template <class T>
+	inline T get ()
+	{
+		T v;
+		if (!_ifs.read ((char*) &v, sizeof (v))) {
+			fail ("unexpected end of file");
+		}
+		return v;
+	}
+
+	inline void get (char* const out, const size_t n)
+	{
+		if (!_ifs.read (out, n)) {
+			fail ("unexpected end of file");
+		}
+	}
+
+	inline string getString ()
+	{
+		string s (get <uint32_t> (), '\0');
+		get (&s [0], s.size ());
+		return s;
+	}
+
+	inline void getRecords (Sequence& gene)
+	{
+		const uint32_t n = get <uint32_t> ();
+		for (uint32_t r = 0; r < n; r++) {
+			gene.Names.push_back (getString ());
+			gene.RecordStart.push_back (get <uint64_t> ());
+		}
+	}
+
+	/*
+	 * End of the blocks: the index if there is a trailer, otherwise the end of the file.
+	 */
+	inline uint64_t blocksEnd ()
+	{
+		const uint64_t pos = _ifs.tellg ();
+		_ifs.seekg (0, ios::end);
+		uint64_t end = _ifs.tellg ();
+		char magic [sizeof (RESULT_MAGIC)];
+		if (end >= pos + 24) {
+			_ifs.seekg (end - 24);
+			const uint64_t indexOffset = get <uint64_t> ();
+			get <uint64_t> ();
+			get (magic, sizeof (magic));
+			if (memcmp (magic, RESULT_MAGIC, sizeof (magic)) == 0 && indexOffset >= pos && indexOffset <= end) {
+				end = indexOffset;
+			}
+		}
+		_ifs.seekg (pos);
+		return end;
+	}
+
+	inline uint64_t tell ()
+	{
+		return _ifs.tellg ();
+	}
+
+	inline void check (const bool ok, const char* const what)
+	{
+		if (!ok) {
+			fail (what);
+		}
+	}
+};
+
+static inline uint64_t decodeVarint (const uint8_t*& p, const uint8_t* const end, bool& ok)
+{
+	uint64_t v = 0;
+	for (int shift = 0; p < end && shift < 64; shift += 7) {
+		const uint8_t b = *p++;
+		v |= (uint64_t) (b & 0x7F) << shift;
+		if (b < 0x80) {
+			return v;
+		}
+	}
+	ok = false;
+	return 0;
+}
+
+void convertResults (const char* const inPath, const char* const outPath)
+{
+	ResultReader in (inPath);
+	char magic [sizeof (RESULT_MAGIC)];
+	in.get (magic, sizeof (magic));
+	in.check (memcmp (magic, RESULT_MAGIC, sizeof (magic)) == 0, "not a binary result file");
+	in.check (in.get <uint32_t> () == RESULT_FILE_VERSION, "unsupported version");
+	const uint32_t flags = in.get <uint32_t> ();
+	const bool recordOutput = flags & RESULT_FILE_RECORDS;
+	const bool strands = flags & RESULT_FILE_STRANDS;
+	in.get <int32_t> ();
+	in.get <uint32_t> ();
+	Sequence gene1 ((const uint8_t*) 0, in.get <uint64_t> (), 0);
+	Sequence gene2 ((const uint8_t*) 0, in.get <uint64_t> (), 0);
+	const string path1 = in.getString ();
+	const string path2 = in.getString ();
+	in.getRecords (gene1);
+	in.getRecords (gene2);
+	/*
+	 * Records are separated by RecordGap, which gives their ends and the records of the reverse complement.
+	 */
+	for (size_t r = 1; r < gene2.records (); r++) {
+		gene2.RecordEnd.push_back (gene2.RecordStart [r] - Sequence::RecordGap);
+	}
+	gene2.RecordEnd.push_back (gene2.Len);
+	unique_ptr <Sequence> reverse2 = gene2.reverseComplement ();
+	const Sequence* const names1 = recordOutput ? &gene1 : 0;
+
+	ofstream ofs (outPath);
+	writeCsvHeader (ofs, path1, path2, recordOutput, strands, false);
+
+	const uint64_t end = in.blocksEnd ();
+	vector <uint8_t> block;
+	vector <char> text;
+	size_t results = 0;
+	while (in.tell () + 8 <= end) {
+		const uint32_t count = in.get <uint32_t> ();
+		const uint32_t bytes = in.get <uint32_t> ();
+		if (in.tell () + bytes > end) {
+			cout << "Ignoring the truncated last block of " << inPath << endl;
+			break;
+		}
+		block.resize (bytes);
+		in.get ((char*) block.data (), bytes);
+
+		const uint8_t* p = block.data ();
+		const uint8_t* const blockEnd = p + bytes;
+		int64_t i = 0;
+		int64_t j = 0;
+		bool ok = true;
+		size_t used = 0;
+		for (uint32_t k = 0; k < count; k++) {
+			const int64_t di = unzigzag (decodeVarint (p, blockEnd, ok));
+			i += di;
+			j += di + unzigzag (decodeVarint (p, blockEnd, ok));
+			const uint64_t score = decodeVarint (p, blockEnd, ok);
+			Result r (i, strands && (score & 1));
+			r.improve (j, strands ? score >> 1 : score);
+			in.check (ok, "invalid block");
+
+			const Sequence* const names2 = !recordOutput ? 0 : r.reverse () ? reverse2.get () : &gene2;
+			const size_t n = r.maxLength (names1, names2);
+			if (text.size () < used + n) {
+				text.resize (max (2 * text.size (), used + n));
+			}
+			used = r.write (text.data () + used, names1, names2, strands) - text.data ();
+		}
+		ofs.write (text.data (), used);
+		results += count;
+	}
+	ofs.close ();
+	if (ofs.fail ()) {
+		cout << "could not write " << outPath << endl;
+		exit (7);
+	}
+	cout << "Converted " << results << " results to " << outPath << endl;
+}
@@ -0,0 +1,127 @@
+#ifndef RESULTFILE_H_INCLUDED
+#define RESULTFILE_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+#include <fstream>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "Options.h"
+#include "Sequence.h"
+
+
+/*
+ * Result files are either CSV text or binary (--binary). Binary files are laid out as follows, all integers little
+ * endian:
+ *
+ * header   "SWRESULT", uint32 version, uint32 flags (1: CSV shows record names, 2: both strands), int32 threshold, uint32 0,
+ *          uint64 len1, uint64 len2, path1, path2, then the record table of either file:
+ *          uint32 count, count times (name, uint64 start). Strings are uint32 length and bytes.
+ * blocks   uint32 count, uint32 bytes, then count results as varints (LEB128):
+ *          zigzag (i - previous i), zigzag ((j - previous j) - (i - previous i)), score
+ *          With both strands, the last one is 2 * score + 1 for hits on the reverse complement, whose j counts along it.
+ *          "previous" starts at 0 in every block, so hits along a diagonal cost 3 bytes.
+ * index    one entry per block: uint64 offset of the block, uint64 count, uint64 smallest i, uint64 largest i
+ * trailer  uint64 offset of the index, uint64 number of blocks, "SWRESULT"
+ *
+ * Blocks are written in the order they are completed, i is only ascending within a block unless the search ran with
+ * --ordered. With --top, results are best first instead. A file without trailer (from an interrupted run) can still
+ * be read block by block.
+ */
+#define RESULT_FILE_VERSION 1
+#define RESULT_FILE_RECORDS 1
+#define RESULT_FILE_STRANDS 2
+
+struct ResultIndexEntry
+{
+	uint64_t Offset;
+	uint64_t Count;
+	uint64_t MinI;
+	uint64_t MaxI;
+};
+
+static inline uint8_t* encodeVarint (uint8_t* p, uint64_t v)
+{
+	while (v >= 0x80) {
+		*p++ = (uint8_t) v | 0x80;
+		v >>= 7;
+	}
+	*p++ = (uint8_t) v;
+	return p;
+}
+
+static inline uint64_t zigzag (const int64_t v)
+{
+	return ((uint64_t) v << 1) ^ (uint64_t) (v >> 63);
+}
+
+static inline int64_t unzigzag (const uint64_t v)
+{
+	return (int64_t) (v >> 1) ^ -(int64_t) (v & 1);
+}
+
+/*
+ * Appends the decimal digits of v without allocating.
+ */
+static inline char* writeDecimal (char* p, uint64_t v)
+{
+	char digits [20];
+	int n = 0;
+	do {
+		digits [n++] = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	while (n > 0) {
+		*p++ = digits [--n];
+	}
+	return p;
+}
+
+/*
+ * Appends two numeric CSV fields.
+ */
+static inline char* writeNumbers (char* p, const uint64_t a, const uint64_t b)
+{
+	p = writeDecimal (p, a);
+	*p++ = ',';
+	p = writeDecimal (p, b);
+	*p++ = ',';
+	return p;
+}
+
+/*
+ * Appends a CSV field and its separator.
+ */
+static inline char* writeField (char* p, const string& s)
+{
+	memcpy (p, s.data (), s.size ());
+	p += s.size ();
+	*p++ = ',';
+	return p;
+}
+
+/*
+ * Writes the CSV header line of hits, regions or full-length alignments, or the header of a binary file. Dot plots
+ * have no header here.
+ */
+void writeResultHeader (
+	ofstream& ofs,
+	const Options& opts,
+	const Sequence& gene1,
+	const Sequence& gene2,
+	const bool recordOutput);
+
+/*
+ * Ends a binary file with the block index and the trailer.
+ */
+void writeResultIndex (ofstream& ofs, const vector <ResultIndexEntry>& index);
+
+/*
+ * Converts a binary result file to CSV block by block, as the search would have written it.
+ * Exits the program if the input is not a result file.
+ */
+void convertResults (const char* const inPath, const char* const outPath);
+
+#endif // RESULTFILE_H_INCLUDED
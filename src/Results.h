@@ -1,10 +1,30 @@
 #ifndef RESULTS_H_INCLUDED
 #define RESULTS_H_INCLUDED
 
-#include <sstream>
-#include <mutex>
+#include <string.h>
 #include <atomic>
+#include <thread>
 #include <fstream>
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+
+#include "Options.h"
+#include "Sequence.h"
+#include "ResultFile.h"
+#include "Regions.h"
+#include "PackedSequence.h"
+#include "Traceback.h"
+#include "LocalAlign.h"
+#include "ScoreMatrix.h"
+#include "DotPlot.h"
+
+class WindowGroups;
+class Band;
+class WindowMask;
+class ChunkStream;
 
 
 class Input
@@ -12,29 +32,131 @@ class Input
 public:
 	const size_t Len1;
 	const size_t Len2;
-	const string Gene1;
-	const string Gene2;
+
+	/*
+	 * Views of the loaded sequences, which outlive the search
+	 */
+	const uint8_t* const Gene1;
+	const uint8_t* const Gene2;
+
+	/*
+	 * The loaded sequences, for their record tables, which stay valid when the data is released
+	 */
+	const Sequence& Seq1;
+	const Sequence& Seq2;
+
+	/*
+	 * 2 bit packed genes, null unless packed mode is enabled. The byte views above are null otherwise.
+	 */
+	const PackedSequence* const Packed1;
+	const PackedSequence* const Packed2;
+
+	/*
+	 * Source of gene1 in streaming mode, null otherwise. Gene1 is null and Len1 is 0 while streaming.
+	 */
+	ChunkStream* const Stream1;
+
+	/*
+	 * Source of gene2 tiles in tile mode, null otherwise. Gene2 is null and Len2 is 0 in tile mode.
+	 */
+	ChunkStream* const Tiles2;
+
 	const int Threshold;
 	const int ThreadCount;
+	const Options& Opts;
+
+	/*
+	 * Batch: one result per row and record of gene2.
+	 * RecordOutput: results are written as record names and positions within the records.
+	 */
+	const bool Batch;
+	const bool RecordOutput;
+
+	/*
+	 * Vertical skip limit to start with, and the largest one that can be of use for this threshold.
+	 */
+	const int MaxSkipLimit;
+	const int SkipLimit;
+	const bool AdaptiveSkipLimit;
+
+	/*
+	 * Groups of identical windows, null unless duplicate elimination is enabled
+	 */
+	const WindowGroups* const Groups1;
+	const WindowGroups* const Groups2;
+
+	/*
+	 * Restricts the search to a diagonal band, null to search everything
+	 */
+	const Band* const BandMap;
+
+	/*
+	 * Window starts that are not searched, null if there are none
+	 */
+	const WindowMask* const Mask1;
+	const WindowMask* const Mask2;
+
+	/*
+	 * Protein mode: the substitution matrix, null for DNA. MaxDelta bounds how much the score of a window pair can
+	 * change when either window moves by one position, which is what the skip distances are derived from.
+	 */
+	const ScoreMatrix* const Matrix;
+	const int MaxDelta;
 
 	double (* const Elapsed) (bool);
 
+	/*
+	 * Both strands: ReverseStrand is set in the inputs of the reverse strand, whose Gene2, Seq2, Packed2 and Mask2
+	 * refer to the reverse complement. Reverse points to them from the forward inputs, it is null otherwise.
+	 */
+	const bool ReverseStrand;
+	Input* Reverse;
+
 	inline Input (
-		size_t len1,
-		size_t len2,
-		string& gene1,
-		string& gene2,
-		int threshold,
-		int nthreads,
-		double (* const elapsed) (bool))
+		const Sequence& gene1,
+		const Sequence& gene2,
+		const PackedSequence* const packed1,
+		const PackedSequence* const packed2,
+		ChunkStream* const stream1,
+		ChunkStream* const tiles2,
+		const Options& opts,
+		const WindowGroups* const groups1,
+		const WindowGroups* const groups2,
+		const Band* const band,
+		const WindowMask* const mask1,
+		const WindowMask* const mask2,
+		const ScoreMatrix* const matrix,
+		double (* const elapsed) (bool),
+		const bool reverseStrand = false)
 	:
-		Len1 (len1),
-		Len2 (len2),
-		Gene1 (gene1),
-		Gene2 (gene2),
-		Threshold (threshold),
-		ThreadCount (nthreads),
-		Elapsed (elapsed)
+		Len1 (gene1.Len),
+		Len2 (gene2.Len),
+		Gene1 (gene1.Data),
+		Gene2 (gene2.Data),
+		Seq1 (gene1),
+		Seq2 (gene2),
+		Packed1 (packed1),
+		Packed2 (packed2),
+		Stream1 (stream1),
+		Tiles2 (tiles2),
+		Threshold (opts.Threshold),
+		ThreadCount (opts.ThreadCount),
+		Opts (opts),
+		Batch (opts.Batch),
+		RecordOutput (!stream1 && !tiles2 && (opts.Batch || gene1.records () > 1 || gene2.records () > 1)),
+		MaxSkipLimit (max (0, min (MAX_VERTICAL_SKIP_LIMIT, (opts.Threshold - 1) / (matrix ? matrix->maxDelta () : 3)))),
+		SkipLimit (min (MaxSkipLimit, opts.SkipLimit == SKIP_LIMIT_ADAPTIVE ? VERTICAL_SKIP_LIMIT : opts.SkipLimit)),
+		AdaptiveSkipLimit (opts.SkipLimit == SKIP_LIMIT_ADAPTIVE),
+		Groups1 (groups1),
+		Groups2 (groups2),
+		BandMap (band),
+		Mask1 (mask1),
+		Mask2 (mask2),
+		Matrix (matrix),
+		MaxDelta (matrix ? matrix->maxDelta () : 3),
+		Elapsed (elapsed),
+		ReverseStrand (reverseStrand),
+		Reverse (0)
 	{
 	}
 };
@@ -42,14 +164,29 @@ public:
 class Result
 {
 private:
-	const size_t I;
+	size_t I;
 	size_t J;
 	int Score;
 
+	/*
+	 * J is a window of the reverse complement of gene2
+	 */
+	bool Reverse;
+
 public:
-	inline Result (const size_t i)
-		: I (i), J (-1), Score (-1)
+	inline Result (const size_t i, const bool reverse = false)
+		: I (i), J (-1), Score (-1), Reverse (reverse)
+	{
+	}
+
+	/*
+	 * The same result for another row, used when two rows are known to be identical.
+	 */
+	inline Result forRow (const size_t i) const
 	{
+		Result r (*this);
+		r.I = i;
+		return r;
 	}
 
 	inline bool isValid () const
@@ -57,18 +194,96 @@ public:
 		return Score >= 0;
 	}
 
-	inline string toString () const
+	/*
+	 * Upper bound of the bytes written by write ()
+	 */
+	inline size_t maxLength (const Sequence* const gene1, const Sequence* const gene2) const
 	{
-		stringstream s;
-		s << I << ",";
-		s << J << ",";
-		s << Score << ",";
-		return s.str ();
+		size_t n = 3 * 21 + 2 + 1;
+		if (gene1) {
+			n += gene1->Names [gene1->findRecord (I)].size () + gene2->Names [gene2->findRecord (J)].size () + 2;
+		}
+		return n;
+	}
+
+	/*
+	 * Writes the CSV line to p and returns its end. If the genes are given, positions are written as record names
+	 * and positions within the records, gene2 being the reverse complement for results on the reverse strand.
+	 * strands adds the strand column, alignment the traceback columns.
+	 */
+	inline char* write (
+		char* p,
+		const Sequence* const gene1,
+		const Sequence* const gene2,
+		const bool strands,
+		const Alignment* const alignment = 0) const
+	{
+		if (gene1) {
+			const size_t r1 = gene1->findRecord (I);
+			const size_t r2 = gene2->findRecord (J);
+			p = writeField (p, gene1->Names [r1]);
+			p = writeDecimal (p, I - gene1->RecordStart [r1]);
+			*p++ = ',';
+			p = writeField (p, gene2->Names [r2]);
+			p = writeDecimal (p, J - gene2->RecordStart [r2]);
+			*p++ = ',';
+		} else {
+			p = writeDecimal (p, I);
+			*p++ = ',';
+			p = writeDecimal (p, J);
+			*p++ = ',';
+		}
+		p = writeDecimal (p, Score);
+		*p++ = ',';
+		if (strands) {
+			*p++ = Reverse ? '-' : '+';
+			*p++ = ',';
+		}
+		if (alignment) {
+			p = alignment->write (p);
+		}
+		*p++ = '\n';
+		return p;
+	}
+
+	/*
+	 * Appends the binary encoding relative to the previous result of the block, see ResultFile.h.
+	 */
+	inline uint8_t* encode (uint8_t* p, size_t& prevI, size_t& prevJ, const bool strands) const
+	{
+		const int64_t di = (int64_t) (I - prevI);
+		const int64_t dj = (int64_t) (J - prevJ);
+		p = encodeVarint (p, zigzag (di));
+		p = encodeVarint (p, zigzag (dj - di));
+		p = encodeVarint (p, strands ? 2 * Score + Reverse : Score);
+		prevI = I;
+		prevJ = J;
+		return p;
+	}
+
+	inline size_t i () const
+	{
+		return I;
+	}
+
+	inline size_t j () const
+	{
+		return J;
+	}
+
+	inline int score () const
+	{
+		return Score;
+	}
+
+	inline bool reverse () const
+	{
+		return Reverse;
 	}
 
 	inline int hash () const
 	{
-		return (I << 20) | (J << 8) | Score;
+		return ((I << 20) | (J << 8) | Score) ^ (Reverse ? 0x2B7E1516 : 0);
 	}
 
 	inline void improve (size_t j, int score)
@@ -81,8 +296,224 @@ public:
 			J = j;
 		}
 	}
+
+	/*
+	 * Takes the better of both results for the same row, with the same tie-break.
+	 */
+	inline void improve (const Result& other)
+	{
+		if (other.isValid ()) {
+			improve (other.J, other.Score);
+		}
+	}
 };
 
+/*
+ * A block of CSV lines or binary results, passed from a search thread to the writer thread.
+ * Count and the range of rows are only kept for the index of binary files, PrevI and PrevJ for their encoding.
+ * In ordered mode, Seq is the row block the results belong to, and Last marks the final block of its results.
+ */
+struct ResultBlock
+{
+	static const size_t NO_SEQ = -1;
+
+	ResultBlock* Next;
+	size_t Used;
+	vector <char> Data;
+	size_t Count;
+	size_t MinI;
+	size_t MaxI;
+	size_t PrevI;
+	size_t PrevJ;
+	size_t Seq;
+	bool Last;
+
+	inline ResultBlock (const size_t capacity, const size_t seq)
+		: Next (0), Used (0), Data (capacity), Count (0), MinI (-1), MaxI (0), PrevI (0), PrevJ (0), Seq (seq), Last (false)
+	{
+	}
+};
+
+/*
+ * The K best results so far, by score and then by position. Once K are known, the K-th score is the threshold every
+ * thread searches with: it only rises, so whatever was skipped before could not have made it either.
+ * Results below the threshold are turned away without taking the lock, which becomes rare as the threshold rises.
+ */
+class TopResults
+{
+private:
+	const size_t _k;
+	mutex _lock;
+	vector <Result> _heap;
+	atomic<int> _threshold;
+
+	/*
+	 * The heap keeps the worst of the K results at its front.
+	 */
+	static inline bool better (const Result& a, const Result& b)
+	{
+		if (a.score () != b.score ()) {
+			return a.score () > b.score ();
+		}
+		if (a.i () != b.i ()) {
+			return a.i () < b.i ();
+		}
+		return a.j () < b.j () || (a.j () == b.j () && !a.reverse () && b.reverse ());
+	}
+
+public:
+	inline TopResults (const size_t k, const int threshold)
+		:
+		_k (k),
+		_lock (),
+		_heap (),
+		_threshold (threshold)
+	{
+		_heap.reserve (k);
+	}
+
+	inline int threshold () const
+	{
+		return _threshold.load (memory_order_relaxed);
+	}
+
+	inline void offer (const Result& res)
+	{
+		if (res.score () < threshold ()) {
+			return;
+		}
+		lock_guard <mutex> lock (_lock);
+		if (_heap.size () < _k) {
+			_heap.push_back (res);
+			push_heap (_heap.begin (), _heap.end (), better);
+		} else if (better (res, _heap.front ())) {
+			pop_heap (_heap.begin (), _heap.end (), better);
+			_heap.back () = res;
+			push_heap (_heap.begin (), _heap.end (), better);
+		} else {
+			return;
+		}
+		if (_heap.size () == _k && _heap.front ().score () > threshold ()) {
+			_threshold = _heap.front ().score ();
+		}
+	}
+
+	/*
+	 * The results, best first. Only valid once no more are offered.
+	 */
+	inline vector <Result> sorted () const
+	{
+		vector <Result> res (_heap);
+		sort (res.begin (), res.end (), better);
+		return res;
+	}
+};
+
+class ResultCollector;
+
+/*
+ * Collects the results of one thread. Lines are formatted into a block, which is handed to the writer thread when
+ * it is full or when the thread flushes. The hash is summed locally and added to the collector on flush.
+ * In ordered mode, the results between begin () and flush () belong to one row block.
+ * In region mode, hits are merged into regions first, which are written once they cannot grow any more.
+ * With --traceback, results wait until TRACEBACK_LANES of them can be aligned together, or the buffer is flushed.
+ * With --dot-plot, results only go into the plot, which is handed to the collector by finishPlot ().
+ * Each buffer must only be used by one thread at a time.
+ */
+class ResultBuffer
+{
+private:
+	ResultCollector& _collector;
+	ResultBlock* _block;
+	int _hash;
+	size_t _seq;
+	unique_ptr <RegionBuilder> _regions;
+	TopResults* const _top;
+
+	/*
+	 * Traceback: the results not aligned yet, room for the unpacked windows of packed genes and for the alignments
+	 */
+	const bool _traceback;
+	vector <Result> _unaligned;
+	vector <uint8_t> _windows;
+	vector <Alignment> _alignments;
+
+	/*
+	 * Dot plot mode, null otherwise
+	 */
+	unique_ptr <DotPlot> _plot;
+
+	inline char* reserve (const size_t n);
+	inline void writeDone ();
+	inline void format (const Result& res, const Alignment* const alignment);
+	inline void writeAligned ();
+
+	/*
+	 * The window at k, unpacked to buffer if only the packed gene is kept
+	 */
+	static inline const uint8_t* window (
+		const uint8_t* const gene,
+		const PackedSequence* const packed,
+		const size_t k,
+		uint8_t* const buffer)
+	{
+		if (gene) {
+			return gene + k;
+		}
+		packed->unpack (k, 50, buffer);
+		return buffer;
+	}
+
+public:
+	inline ResultBuffer (ResultCollector& collector);
+
+	inline ~ResultBuffer ()
+	{
+		flush ();
+		finishPlot ();
+	}
+
+	/*
+	 * Starts the results of the rows [i0, i1), row block seq in ordered mode.
+	 * Waits while the block is too far ahead of the blocks written so far.
+	 */
+	inline void begin (const size_t seq, const size_t i0, const size_t i1);
+
+	/*
+	 * Reports a result, which is merged into a region or offered to the top results first if these modes are enabled.
+	 */
+	inline void add (const Result& res);
+
+	/*
+	 * Writes a result or region as it is.
+	 */
+	inline void write (const Result& res);
+	inline void write (const HitRegion& region);
+	inline void write (const LocalAlignment& alignment);
+
+	inline void flush ();
+
+	/*
+	 * Merges the dot plot into the one of the collector.
+	 */
+	inline void finishPlot ();
+
+	ResultBuffer (const ResultBuffer&) = delete;
+	ResultBuffer& operator = (const ResultBuffer&) = delete;
+};
+
+/*
+ * Writes the results on a thread of its own.
+ *
+ * Full blocks are pushed onto a stack. The writer sleeps until there is one, takes the whole stack at once, restores
+ * the order in which the blocks were pushed, and writes every block with a single call. Producers sleep while too
+ * many blocks are queued, so memory stays bounded when the disk is slower than the search.
+ *
+ * In ordered mode, the writer holds back the results of each row block until all blocks before it are written.
+ * Threads only start a row block within a window of the last one written, which bounds the results held back.
+ * Held blocks leave the queue: if they counted against it, the thread of the oldest row block could wait for room
+ * that only its own results would free.
+ */
 class ResultCollector
 {
 #if SKIPPING_STATS
@@ -94,13 +525,125 @@ public:
 
 private:
 	Input& _inputs;
-	mutex _lockResults;
 	ofstream* const _ofs;
 	atomic<int> _completed;
+	atomic<int> _hash;
 
-public:
-	int resultHash;
+	const bool _binary;
+	vector <ResultIndexEntry> _index;
+
+	/*
+	 * The stack of queued blocks and the number in it. _work wakes the writer, _room the threads waiting for room in
+	 * the queue or for their turn.
+	 */
+	mutex _queueLock;
+	condition_variable _work;
+	condition_variable _room;
+	ResultBlock* _pending;
+	int _queued;
+	bool _stopping;
+
+	const size_t _window;
+	map <size_t, vector <ResultBlock*>> _held;
+	atomic<size_t> _written;
+
+	/*
+	 * Region pieces at the edges of the threads' row ranges, joined by finish ()
+	 */
+	mutex _edgeLock;
+	vector <HitRegion> _edges;
+
+	/*
+	 * Dot plot mode: the merged plot of all buffers, null otherwise
+	 */
+	mutex _plotLock;
+	unique_ptr <DotPlot> _plot;
 
+	thread _writer;
+
+	/*
+	 * Top-K mode, null otherwise. Declared before the buffer that refers to it.
+	 */
+	unique_ptr <TopResults> _top;
+
+	/*
+	 * Results reported directly through add (), only used by the thread that runs the search.
+	 */
+	ResultBuffer _direct;
+
+	inline void write (ResultBlock* const b)
+	{
+		if (b->Count > 0) {
+			if (_binary) {
+				_index.push_back ({ (uint64_t) _ofs->tellp (), b->Count, b->MinI, b->MaxI });
+				const uint32_t head [2] = { (uint32_t) b->Count, (uint32_t) b->Used };
+				_ofs->write ((const char*) head, sizeof (head));
+			}
+			_ofs->write (b->Data.data (), b->Used);
+		}
+		delete b;
+	}
+
+	/*
+	 * Writes the row blocks that are complete and next in order.
+	 */
+	inline void writeHeld ()
+	{
+		size_t seq = _written;
+		for (auto h = _held.begin (); h != _held.end () && h->first == seq && h->second.back ()->Last; h = _held.erase (h)) {
+			for (ResultBlock* held : h->second) {
+				write (held);
+			}
+			seq++;
+		}
+		_written = seq;
+	}
+
+	inline void writeAll ()
+	{
+		for (;;) {
+			unique_lock <mutex> lock (_queueLock);
+			_work.wait (lock, [this] { return _pending || _stopping; });
+			ResultBlock* b = _pending;
+			if (!b) {
+				return;
+			}
+			_pending = 0;
+			lock.unlock ();
+
+			ResultBlock* ordered = 0;
+			int taken = 0;
+			while (b) {
+				ResultBlock* next = b->Next;
+				b->Next = ordered;
+				ordered = b;
+				b = next;
+				taken++;
+			}
+			while (ordered) {
+				ResultBlock* next = ordered->Next;
+				if (ordered->Seq == ResultBlock::NO_SEQ) {
+					// anything pushed before it that can be written goes first
+					writeHeld ();
+					write (ordered);
+				} else {
+					_held [ordered->Seq].push_back (ordered);
+				}
+				ordered = next;
+			}
+			writeHeld ();
+			_ofs->flush ();
+
+			// blocks moved to _held are taken as well, the ordered window bounds them
+			// also wakes the threads waiting for their turn, which check _written under the lock
+			lock.lock ();
+			_queued -= taken;
+			lock.unlock ();
+			_room.notify_all ();
+		}
+	}
+
+public:
 	inline ResultCollector (Input& inputs, ofstream* const ofs)
 	:
 #if SKIPPING_STATS
@@ -109,22 +652,162 @@ public:
 		skippedVert (0),
 #endif
 		_inputs (inputs),
-		_lockResults (),
 		_ofs (ofs),
 		_completed (0),
-		resultHash (0)
+		_hash (0),
+		_binary (inputs.Opts.Binary),
+		_index (),
+		_queueLock (),
+		_work (),
+		_room (),
+		_pending (0),
+		_queued (0),
+		_stopping (false),
+		_window (RESULT_REORDER_BLOCKS_PER_THREAD * inputs.ThreadCount),
+		_held (),
+		_written (0),
+		_edgeLock (),
+		_edges (),
+		_plotLock (),
+		_plot (newPlot (inputs)),
+		_writer (&ResultCollector::writeAll, this),
+		_top (inputs.Opts.TopK > 0 ? new TopResults (inputs.Opts.TopK, inputs.Threshold) : 0),
+		_direct (*this)
+	{
+	}
+
+	inline ~ResultCollector ()
 	{
+		finish ();
 	}
 
-	inline void add (Result& res)
+	inline const Input& inputs () const
 	{
-		if (res.isValid ()) {
-			_lockResults.lock ();
-			(*_ofs) << res.toString () << "\n";
-			(*_ofs) << flush;
-			resultHash += res.hash ();
-			_lockResults.unlock ();
+		return _inputs;
+	}
+
+	/*
+	 * An empty dot plot of the inputs, null unless dot plot mode is enabled
+	 */
+	static inline DotPlot* newPlot (const Input& inputs)
+	{
+		const Options& opts = inputs.Opts;
+		return opts.DotPlot ? new DotPlot (opts.DotPlotSize, inputs.Len1, inputs.Len2, opts.DotPlotCount) : 0;
+	}
+
+	inline void plot (DotPlot& part)
+	{
+		lock_guard <mutex> lock (_plotLock);
+		_plot->merge (part);
+	}
+
+	inline bool binary () const
+	{
+		return _binary;
+	}
+
+	inline TopResults* top () const
+	{
+		return _top.get ();
+	}
+
+	/*
+	 * The threshold to search with, which rises in top-K mode
+	 */
+	inline int threshold () const
+	{
+		return _top ? _top->threshold () : _inputs.Threshold;
+	}
+
+	inline void push (ResultBlock* const b, const int hash)
+	{
+		_hash += hash;
+		if (!b) {
+			return;
 		}
+		unique_lock <mutex> lock (_queueLock);
+		_room.wait (lock, [this] { return _queued < RESULT_QUEUE_BLOCKS; });
+		_queued++;
+		b->Next = _pending;
+		_pending = b;
+		lock.unlock ();
+		_work.notify_one ();
+	}
+
+	inline void hold (vector <HitRegion>& edges)
+	{
+		lock_guard <mutex> lock (_edgeLock);
+		_edges.insert (_edges.end (), edges.begin (), edges.end ());
+		edges.clear ();
+	}
+
+	/*
+	 * Whether the time budget is used up, never without one
+	 */
+	inline bool expired () const
+	{
+		return _inputs.Opts.TimeBudget > 0 && _inputs.Elapsed (true) >= _inputs.Opts.TimeBudget;
+	}
+
+	inline void waitForTurn (const size_t seq)
+	{
+		unique_lock <mutex> lock (_queueLock);
+		_room.wait (lock, [this, seq] { return seq < _written + _window; });
+	}
+
+	inline void add (const Result& res)
+	{
+		_direct.add (res);
+	}
+
+	inline void add (const LocalAlignment& alignment)
+	{
+		_direct.write (alignment);
+	}
+
+	/*
+	 * Hands the results reported through add () so far to the writer.
+	 */
+	inline void flush ()
+	{
+		_direct.flush ();
+	}
+
+	/*
+	 * Writes everything reported so far and returns the hash of all results. Threads must have flushed their buffers.
+	 */
+	inline int finish ()
+	{
+		if (_writer.joinable ()) {
+			_direct.flush ();
+			if (_inputs.Opts.Regions) {
+				for (auto& r : RegionBuilder::stitch (_edges, _inputs.Opts.RegionGap, _inputs.Opts.RegionGap)) {
+					_direct.write (r);
+				}
+				_direct.flush ();
+			}
+			if (_top) {
+				for (auto& r : _top->sorted ()) {
+					_direct.write (r);
+				}
+				_direct.flush ();
+			}
+			{
+				lock_guard <mutex> lock (_queueLock);
+				_stopping = true;
+			}
+			_work.notify_one ();
+			_writer.join ();
+			if (_binary) {
+				writeResultIndex (*_ofs, _index);
+			}
+			if (_plot) {
+				_direct.finishPlot ();
+				_plot->write (*_ofs, _inputs.Opts);
+			}
+			_ofs->flush ();
+		}
+		return _hash;
 	}
 
 	inline void complete (int count)
@@ -132,14 +815,203 @@ public:
 		int done = _completed += count;
 		const int output_interval = 100000;
 		if (done / output_interval != (done - count) / output_interval) {
-			auto perc = 100.0 * done / _inputs.Len1;
 			auto dur = _inputs.Elapsed (false);
 			auto spd = 1.0 * done / dur;
+			if (_inputs.Len1 == 0) {
+				printf ("%d (streaming, %.0f/s)\n", done, spd);
+				return;
+			}
+			auto perc = 100.0 * done / _inputs.Len1;
 			printf ("%d / %zu (%.3f%%, %.0f/s)\n",
 			        done, _inputs.Len1, perc, spd);
 		}
 	}
 };
 
+inline ResultBuffer::ResultBuffer (ResultCollector& collector)
+	:
+	_collector (collector),
+	_block (0),
+	_hash (0),
+	_seq (ResultBlock::NO_SEQ),
+	_regions (),
+	_top (collector.top ()),
+	_traceback (collector.inputs ().Opts.Traceback),
+	_unaligned (),
+	_windows (),
+	_alignments (),
+	_plot (ResultCollector::newPlot (collector.inputs ()))
+{
+	const Options& opts = collector.inputs ().Opts;
+	if (opts.Regions) {
+		_regions.reset (new RegionBuilder (opts.RegionGap, opts.RegionGap));
+	}
+	if (_traceback) {
+		_unaligned.reserve (TRACEBACK_LANES);
+		_windows.resize (2 * TRACEBACK_LANES * 50);
+		_alignments.resize (TRACEBACK_LANES);
+	}
+}
+
+/*
+ * Returns room for n bytes in the current block, which the caller fills and adds to Used.
+ */
+inline char* ResultBuffer::reserve (const size_t n)
+{
+	if (_block && _block->Used + n > _block->Data.size ()) {
+		_collector.push (_block, 0);
+		_block = 0;
+	}
+	if (!_block) {
+		_block = new ResultBlock (max ((size_t) RESULT_BLOCK_BYTES, n), _seq);
+	}
+	return _block->Data.data () + _block->Used;
+}
+
+inline void ResultBuffer::add (const Result& res)
+{
+	if (!res.isValid ()) {
+		return;
+	}
+	if (_regions) {
+		_hash += res.hash ();
+		_regions->add (HitRegion (res.i (), res.j (), res.score (), res.reverse ()));
+		writeDone ();
+		return;
+	}
+	if (_top) {
+		_top->offer (res);
+		return;
+	}
+	if (_plot) {
+		_hash += res.hash ();
+		_plot->add (res.i (), res.j (), res.score (), res.reverse ());
+		return;
+	}
+	write (res);
+}
+
+inline void ResultBuffer::write (const Result& res)
+{
+	if (_traceback) {
+		_unaligned.push_back (res);
+		if (_unaligned.size () == TRACEBACK_LANES) {
+			writeAligned ();
+		}
+		return;
+	}
+	format (res, 0);
+}
+
+inline void ResultBuffer::writeAligned ()
+{
+	const Input& inputs = _collector.inputs ();
+	const uint8_t* windows1 [TRACEBACK_LANES];
+	const uint8_t* windows2 [TRACEBACK_LANES];
+	for (size_t k = 0; k < _unaligned.size (); k++) {
+		const Result& res = _unaligned [k];
+		const Input& strand = res.reverse () ? *inputs.Reverse : inputs;
+		uint8_t* const buffer = _windows.data () + 2 * 50 * k;
+		windows1 [k] = window (inputs.Gene1, inputs.Packed1, res.i (), buffer);
+		windows2 [k] = window (strand.Gene2, strand.Packed2, res.j (), buffer + 50);
+	}
+	traceback (windows1, windows2, _unaligned.size (), _alignments.data ());
+	for (size_t k = 0; k < _unaligned.size (); k++) {
+		format (_unaligned [k], &_alignments [k]);
+	}
+	_unaligned.clear ();
+}
+
+inline void ResultBuffer::format (const Result& res, const Alignment* const alignment)
+{
+	const Input& inputs = _collector.inputs ();
+	const Sequence* const gene1 = inputs.RecordOutput ? &inputs.Seq1 : 0;
+	const Sequence* const gene2 = !inputs.RecordOutput ? 0 : res.reverse () ? &inputs.Reverse->Seq2 : &inputs.Seq2;
+	const bool strands = inputs.Opts.BothStrands;
+	const size_t n = res.maxLength (gene1, gene2) + (alignment ? Alignment::maxLength () : 0);
+	char* const p = reserve (_collector.binary () ? 3 * 10 : n);
+	char* const end = _collector.binary ()
+		? (char*) res.encode ((uint8_t*) p, _block->PrevI, _block->PrevJ, strands)
+		: res.write (p, gene1, gene2, strands, alignment);
+	_block->Used = end - _block->Data.data ();
+	_block->Count++;
+	_block->MinI = min (_block->MinI, res.i ());
+	_block->MaxI = max (_block->MaxI, res.i ());
+	_hash += res.hash ();
+}
+
+inline void ResultBuffer::write (const HitRegion& region)
+{
+	const Input& inputs = _collector.inputs ();
+	const Sequence* const gene1 = inputs.RecordOutput ? &inputs.Seq1 : 0;
+	const Sequence* const gene2 = !inputs.RecordOutput ? 0 : region.Reverse ? &inputs.Reverse->Seq2 : &inputs.Seq2;
+	char* const end = region.write (reserve (region.maxLength (gene1, gene2)), gene1, gene2, inputs.Opts.BothStrands);
+	_block->Used = end - _block->Data.data ();
+	_block->Count++;
+	_block->MinI = min (_block->MinI, region.I0);
+	_block->MaxI = max (_block->MaxI, region.I0);
+}
+
+inline void ResultBuffer::write (const LocalAlignment& alignment)
+{
+	const Input& inputs = _collector.inputs ();
+	const Sequence* const gene1 = inputs.RecordOutput ? &inputs.Seq1 : 0;
+	const Sequence* const gene2 = inputs.RecordOutput ? &inputs.Seq2 : 0;
+	char* const end = alignment.write (reserve (alignment.maxLength (gene1, gene2)), gene1, gene2);
+	_block->Used = end - _block->Data.data ();
+	_block->Count++;
+	_block->MinI = min (_block->MinI, alignment.I0);
+	_block->MaxI = max (_block->MaxI, alignment.I0);
+	_hash += alignment.hash ();
+}
+
+inline void ResultBuffer::writeDone ()
+{
+	for (auto& r : _regions->Done) {
+		write (r);
+	}
+	_regions->Done.clear ();
+}
+
+inline void ResultBuffer::begin (const size_t seq, const size_t i0, const size_t i1)
+{
+	if (seq != ResultBlock::NO_SEQ) {
+		_collector.waitForTurn (seq);
+	}
+	_seq = seq;
+	if (_regions) {
+		_regions->begin (i0, i1);
+	}
+}
+
+inline void ResultBuffer::flush ()
+{
+	if (!_unaligned.empty ()) {
+		writeAligned ();
+	}
+	if (_regions) {
+		_regions->finish ();
+		writeDone ();
+		_collector.hold (_regions->Edge);
+	}
+	if (_seq != ResultBlock::NO_SEQ) {
+		if (!_block) {
+			_block = new ResultBlock (0, _seq);
+		}
+		_block->Last = true;
+		_seq = ResultBlock::NO_SEQ;
+	}
+	_collector.push (_block, _hash);
+	_block = 0;
+	_hash = 0;
+}
+
+inline void ResultBuffer::finishPlot ()
+{
+	if (_plot && !_plot->empty ()) {
+		_collector.plot (*_plot);
+	}
+}
+
 
 #endif // RESULTS_H_INCLUDED
@@ -0,0 +1,152 @@
+#include <string.h>
+#include <strings.h>
+#include <ctype.h>
+#include <algorithm>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <vector>
+
+#include "ScoreMatrix.h"
+
+
+static const char* const BLOSUM62 =
+	"   A  R  N  D  C  Q  E  G  H  I  L  K  M  F  P  S  T  W  Y  V  B  Z  X  *\n"
+	"A  4 -1 -2 -2  0 -1 -1  0 -2 -1 -1 -1 -1 -2 -1  1  0 -3 -2  0 -2 -1  0 -4\n"
+	"R -1  5  0 -2 -3  1  0 -2  0 -3 -2  2 -1 -3 -2 -1 -1 -3 -2 -3 -1  0 -1 -4\n"
+	"N -2  0  6  1 -3  0  0  0  1 -3 -3  0 -2 -3 -2  1  0 -4 -2 -3  3  0 -1 -4\n"
+	"D -2 -2  1  6 -3  0  2 -1 -1 -3 -4 -1 -3 -3 -1  0 -1 -4 -3 -3  4  1 -1 -4\n"
+	"C  0 -3 -3 -3  9 -3 -4 -3 -3 -1 -1 -3 -1 -2 -3 -1 -1 -2 -2 -1 -3 -3 -2 -4\n"
+	"Q -1  1  0  0 -3  5  2 -2  0 -3 -2  1  0 -3 -1  0 -1 -2 -1 -2  0  3 -1 -4\n"
+	"E -1  0  0  2 -4  2  5 -2  0 -3 -3  1 -2 -3 -1  0 -1 -3 -2 -2  1  4 -1 -4\n"
+	"G  0 -2  0 -1 -3 -2 -2  6 -2 -4 -4 -2 -3 -3 -2  0 -2 -2 -3 -3 -1 -2 -1 -4\n"
+	"H -2  0  1 -1 -3  0  0 -2  8 -3 -3 -1 -2 -1 -2 -1 -2 -2  2 -3  0  0 -1 -4\n"
+	"I -1 -3 -3 -3 -1 -3 -3 -4 -3  4  2 -3  1  0 -3 -2 -1 -3 -1  3 -3 -3 -1 -4\n"
+	"L -1 -2 -3 -4 -1 -2 -3 -4 -3  2  4 -2  2  0 -3 -2 -1 -2 -1  1 -4 -3 -1 -4\n"
+	"K -1  2  0 -1 -3  1  1 -2 -1 -3 -2  5 -1 -3 -1  0 -1 -3 -2 -2  0  1 -1 -4\n"
+	"M -1 -1 -2 -3 -1  0 -2 -3 -2  1  2 -1  5  0 -2 -1 -1 -1 -1  1 -3 -1 -1 -4\n"
+	"F -2 -3 -3 -3 -2 -3 -3 -3 -1  0  0 -3  0  6 -4 -2 -2  1  3 -1 -3 -3 -1 -4\n"
+	"P -1 -2 -2 -1 -3 -1 -1 -2 -2 -3 -3 -1 -2 -4  7 -1 -1 -4 -3 -2 -2 -1 -2 -4\n"
+	"S  1 -1  1  0 -1  0  0  0 -1 -2 -2  0 -1 -2 -1  4  1 -3 -2 -2  0  0  0 -4\n"
+	"T  0 -1  0 -1 -1 -1 -1 -2 -2 -1 -1 -1 -1 -2 -1  1  5 -2 -2  0 -1 -1  0 -4\n"
+	"W -3 -3 -4 -4 -2 -2 -3 -2 -2 -3 -2 -3 -1  1 -4 -3 -2 11  2 -3 -4 -3 -2 -4\n"
+	"Y -2 -2 -2 -3 -2 -1 -2 -3  2 -1 -1 -2 -1  3 -3 -2 -2  2  7 -1 -3 -2 -1 -4\n"
+	"V  0 -3 -3 -3 -1 -2 -2 -3 -3  3  1 -2  1 -1 -2 -2  0 -3 -1  4 -3 -2 -1 -4\n"
+	"B -2 -1  3  4 -3  0  1 -1  0 -3 -4  0 -3 -3 -2  0 -1 -4 -3 -3  4  1 -1 -4\n"
+	"Z -1  0  0  1 -3  3  4 -2  0 -3 -3  1 -1 -3 -1  0 -1 -3 -2 -2  1  4 -1 -4\n"
+	"X  0 -1 -1 -1 -2 -1 -1 -1 -1 -1 -1 -1 -1 -1 -2  0  0 -2 -1 -1 -1 -1 -1 -4\n"
+	"* -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4 -4  1\n";
+
+static void fail (const char* const nameOrPath)
+{
+	cout << "invalid substitution matrix " << nameOrPath << endl;
+	exit (7);
+}
+
+ScoreMatrix::ScoreMatrix (const char* const nameOrPath, const int gap)
+	:
+	Name (nameOrPath),
+	Gap (gap),
+	MinScore (0),
+	MaxScore (0),
+	Weights ()
+{
+	string text;
+	if (strcasecmp (nameOrPath, "blosum62") == 0) {
+		text = BLOSUM62;
+	} else {
+		ifstream ifs (nameOrPath);
+		if (!ifs) {
+			cout << "unknown matrix or could not open path " << nameOrPath << endl;
+			exit (7);
+		}
+		stringstream ss;
+		ss << ifs.rdbuf ();
+		text = ss.str ();
+	}
+
+	/*
+	 * The column letters, then one row per letter, comment lines start with #.
+	 */
+	vector <char> letters;
+	vector <vector <int>> rows;
+	vector <char> rowLetters;
+	istringstream lines (text);
+	string line;
+	while (getline (lines, line)) {
+		istringstream tokens (line);
+		string t;
+		if (!(tokens >> t) || t [0] == '#') {
+			continue;
+		}
+		if (letters.empty ()) {
+			do {
+				if (t.size () != 1) {
+					fail (nameOrPath);
+				}
+				letters.push_back (toupper (t [0]));
+			} while (tokens >> t);
+			continue;
+		}
+		if (t.size () != 1) {
+			fail (nameOrPath);
+		}
+		rowLetters.push_back (toupper (t [0]));
+		rows.push_back (vector <int> ());
+		int v;
+		while (tokens >> v) {
+			rows.back ().push_back (v);
+		}
+		if (rows.back ().size () != letters.size () || !tokens.eof ()) {
+			fail (nameOrPath);
+		}
+	}
+	if (letters.empty () || rows.size () != letters.size ()) {
+		fail (nameOrPath);
+	}
+
+	int scores [64][64];
+	bool listed [64] = {};
+	MinScore = MaxScore = rows [0][0];
+	for (auto& r : rows) {
+		for (int v : r) {
+			MinScore = min (MinScore, v);
+			MaxScore = max (MaxScore, v);
+		}
+	}
+	for (int a = 0; a < 64; a++) {
+		for (int b = 0; b < 64; b++) {
+			scores [a][b] = MinScore;
+		}
+	}
+	for (size_t r = 0; r < rows.size (); r++) {
+		for (size_t c = 0; c < letters.size (); c++) {
+			scores [slot (rowLetters [r])][slot (letters [c])] = rows [r][c];
+		}
+		listed [slot (rowLetters [r])] = true;
+	}
+
+	// letters the matrix does not know score like X
+	const int x = slot ('X');
+	for (char l = 'A'; l <= 'Z'; l++) {
+		const int a = slot (l);
+		if (listed [a] || !listed [x]) {
+			continue;
+		}
+		for (int b = 0; b < 64; b++) {
+			scores [a][b] = scores [x][b];
+			scores [b][a] = scores [b][x];
+		}
+		scores [a][a] = scores [x][x];
+	}
+
+	if (MaxScore <= 0 || MaxScore + Gap + bias () > 255) {
+		cout << "the scores of " << nameOrPath << " must be positive somewhere and cover less than 255 with the gap" << endl;
+		exit (7);
+	}
+	for (int a = 0; a < 64; a++) {
+		for (int b = 0; b < 64; b++) {
+			Weights [a][b] = scores [a][b] + Gap + bias ();
+		}
+	}
+}
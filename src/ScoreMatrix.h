@@ -0,0 +1,64 @@
+#ifndef SCOREMATRIX_H_INCLUDED
+#define SCOREMATRIX_H_INCLUDED
+
+#include <stdint.h>
+#include <string>
+using namespace std;
+
+
+/*
+ * Substitution scores for protein mode, with a linear gap penalty.
+ *
+ * Cells are scored as max (0, diagonal + score (a, b), up - Gap, left - Gap), which is the DNA scoring of compare.h
+ * with +2 for a match, -1 for a mismatch and a gap penalty of 1.
+ *
+ * Residues are looked up by slot (), so both cases of a letter share a row. Letters the matrix does not list score
+ * like X, other bytes (the fill between records in particular) score the matrix minimum against everything.
+ */
+class ScoreMatrix
+{
+public:
+	string Name;
+	int Gap;
+	int MinScore;
+	int MaxScore;
+
+	/*
+	 * Score (a, b) + Gap + bias (), which is never negative and lets the kernels add with unsigned saturation
+	 */
+	uint8_t Weights [64][64];
+
+	/*
+	 * A built-in matrix (blosum62) or a matrix file in NCBI format. Exits the program on invalid input.
+	 */
+	ScoreMatrix (const char* const nameOrPath, const int gap);
+
+	/*
+	 * The row of byte b: lower case letters are folded to upper case, then the low 6 bits are taken.
+	 */
+	static inline int slot (const uint8_t b)
+	{
+		return (b >= 'a' && b <= 'z' ? b - 32 : b) & 63;
+	}
+
+	inline int score (const uint8_t a, const uint8_t b) const
+	{
+		return Weights [slot (a)][slot (b)] - Gap - bias ();
+	}
+
+	inline int bias () const
+	{
+		return MinScore + Gap < 0 ? -(MinScore + Gap) : 0;
+	}
+
+	/*
+	 * The largest increase of a cell over its diagonal neighbour before the gap is subtracted, as 3 is for DNA.
+	 * Moving a window by one position changes its score by at most this much, which gives the skip distances.
+	 */
+	inline int maxDelta () const
+	{
+		return MaxScore + Gap;
+	}
+};
+
+#endif // SCOREMATRIX_H_INCLUDED
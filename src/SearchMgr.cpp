@@ -2,6 +2,7 @@
 #include <string.h>
 #include <vector>
 #include <thread>
+#include <chrono>
 #include <assert.h>
 #include <queue>
 
@@ -10,21 +11,124 @@
 #include "compare.h"
 
 #include "Skipper.h"
+#include "SkipLimitTuner.h"
+#include "WindowDedup.h"
+#include "Band.h"
+#include "Mask.h"
+#include "PackedSequence.h"
+#include "Stream.h"
+#include "LocalAlign.h"
 
 
+template <class Skipper>
 class SearchThread
 {
 private:
-	const size_t _i0;
-	const size_t _i1;
+	size_t _i0;
+	size_t _i1;
 	Input& _inputs;
 	ResultCollector& _results;
+	ResultBuffer _out;
 
-	const uint8_t* const g1;
-	const uint8_t* const g2;
-	const size_t len2;
+	/*
+	 * Row block of the current rows in ordered mode, ResultBlock::NO_SEQ otherwise
+	 */
+	size_t _seq;
+
+	/*
+	 * Row i starts at g1 [i - _g1Base], _g1Base is only non-zero for chunks of a stream.
+	 */
+	const uint8_t* g1;
+	size_t _g1Base;
+	/*
+	 * In tile mode, g2 and len2 describe the current tile of gene2, whose first window is _g2Base.
+	 */
+	const uint8_t* g2;
+	size_t len2;
+	size_t _g2Base;
+
+	/*
+	 * Packed mode, both null otherwise. The current gene1 window is unpacked into _rowBytes and, as the packed
+	 * kernel wants it, into _rowCodes and _rowCase. Windows with exceptions are unpacked into _window2 and compared
+	 * byte by byte, _exRun follows the exception runs of gene2 along the row.
+	 */
+	const PackedSequence* const _packed1;
+	const PackedSequence* const _packed2;
+	uint8_t _rowBytes [64];
+	uint8_t _rowCodes [64];
+	uint8_t _rowCase [64];
+	uint8_t _window2 [64];
+	bool _rowException;
+	size_t _exRun;
+
+	/*
+	 * Protein mode: the substitution matrix and the largest score change per position, null and 3 otherwise
+	 */
+	const ScoreMatrix* const _matrix;
+	const int _maxDelta;
+
+	/*
+	 * Columns are handled relative to _origin, the skipper only covers _width of them.
+	 * Without a band, this is the whole of gene2, or the largest tile in tile mode. In banded mode it is the band,
+	 * which moves along with the rows.
+	 * Of these, only [_jBegin, _jEnd) lie within gene2.
+	 */
+	const Band* const _band;
+	const size_t _width;
+	int64_t _origin;
+	size_t _jBegin;
+	size_t _jEnd;
+
+	/*
+	 * Masked windows, null if there are none. _maskRun follows the runs of gene2 along the current row.
+	 */
+	const WindowMask* const _mask1;
+	const WindowMask* const _mask2;
+	size_t _maskRun;
+
+	/*
+	 * Batch mode: the results of the current row for earlier records of gene2 are collected in _batch, best only
+	 * covers the record before _nextRecord2. Without batch mode, _nextRecord2 is never reached.
+	 */
+	vector <Result> _batch;
+	size_t _nextRecord2;
+
+	/*
+	 * Threshold of the current row, which only rises in top-K mode
+	 */
+	int _threshold;
+
+	/*
+	 * All-hits mode reports every hit as it is found, to _sink or into _sample while timing the strategies.
+	 */
+	vector <Result>* _sample;
+	ResultBuffer* _sink;
+
+	/*
+	 * Both strands: the search of the reverse complement, which follows this one row by row and reports through it.
+	 * Null on the reverse strand itself and if only the forward strand is searched.
+	 */
+	unique_ptr <SearchThread> _reverse;
+
+	/*
+	 * Duplicate window handling, both null unless enabled.
+	 * Scores of gene2 windows with duplicates are cached per row, indexed by their slot and tagged with _rowStamp.
+	 */
+	DuplicateRows* const _dups;
+	const WindowGroups* const _groups2;
+	vector <uint32_t> _cachedRow;
+	vector <uint16_t> _cachedScore;
+	uint32_t _rowStamp;
+
+	/*
+	 * Lane mode: the best result and, with all hits, the hits of each row of the current lanes
+	 */
+	vector <Result> _laneBest;
+	vector <vector <Result>> _laneHits;
 #if REQUIRE_SKIP_MAP
 	Skipper _skip;
+	int _skipLimit;
+	SkipLimitTuner _tuner;
 #endif
 
 public:
@@ -33,40 +137,149 @@ public:
 		const size_t i0,
 		const size_t i1,
 		Input& inputs,
-		ResultCollector& results)
+		ResultCollector& results,
+		DuplicateRows* const dups,
+		const Chunk* const tile2 = 0)
 		:
 		_i0 (i0),
 		_i1 (i1),
 		_inputs (inputs),
 		_results (results),
+		_out (results),
+		_seq (ResultBlock::NO_SEQ),
+
+		g1 (_inputs.Gene1),
+		_g1Base (0),
+		g2 (tile2 ? tile2->Data.data () : _inputs.Gene2),
+		len2 (tile2 ? tile2->Rows : _inputs.Len2),
+		_g2Base (tile2 ? tile2->Start : 0),
+
+		_packed1 (_inputs.Packed1),
+		_packed2 (_inputs.Packed2),
+		_rowException (false),
+		_exRun (0),
+
+		_matrix (_inputs.Matrix),
+		_maxDelta (_inputs.MaxDelta),
+
+		_band (_inputs.BandMap),
+		_width (_band ? _band->width () : tile2 ? _inputs.Opts.TileSize : len2),
+		_origin (_band ? _band->origin (i0) : 0),
+		_jBegin (0),
+		_jEnd (min (_width, len2)),
+
+		_mask1 (_inputs.Mask1),
+		_mask2 (_inputs.Mask2),
+		_maskRun (0),
+
+		_batch (),
+		_nextRecord2 (-1),
+		_threshold (_inputs.Threshold),
+		_sample (0),
+		_sink (&_out),
+		_reverse (_inputs.Reverse ? new SearchThread (threadId, i0, i1, *_inputs.Reverse, results, dups, tile2) : 0),
 
-		g1 ((const uint8_t*) _inputs.Gene1.c_str ()),
-		g2 ((const uint8_t*) _inputs.Gene2.c_str ()),
-		len2 (_inputs.Len2)
+		_dups (dups),
+		_groups2 (_inputs.Groups2),
+		_cachedRow (_groups2 ? _groups2->First.size () : 0, 0),
+		_cachedScore (_groups2 ? _groups2->First.size () : 0, 0),
+		_rowStamp (0),
+		_laneHits (_inputs.Opts.Lanes ? COMPARE_LANES : 0)
 #if REQUIRE_SKIP_MAP
-		, _skip (len2)
+		, _skip (_width, _inputs.SkipLimit)
+		, _skipLimit (_inputs.SkipLimit)
+		, _tuner (_inputs.MaxSkipLimit)
 #endif
 	{
+		if (_reverse) {
+			_reverse->_sink = &_out;
+		}
+	}
+
+	/*
+	 * Unpacks the gene1 window of row i and returns it. Only a packed kernel needs the codes and the exceptions.
+	 */
+	inline const uint8_t* beginPackedRow (const size_t i)
+	{
+		_packed1->unpack (i, 50, _rowBytes);
+#ifdef COMPARE_PACKED
+		_rowException = _packed1->hasException (i, i + 50);
+		for (int y = 0; y < 50; y++) {
+			const uint8_t* bits = _packed1->Bits;
+			_rowCodes [y] = ((bits [(i + y) >> 2] >> (2 * ((i + y) & 3))) & 3) * 0x55;
+			_rowCase [y] = _rowBytes [y] >= 'a' ? 0xFF : 0;
+		}
+		_exRun = _packed2->findRun ((size_t) _origin + _jBegin);
+#endif
+		return _rowBytes;
+	}
+
+	inline int comparePacked (const uint8_t* const p1, const size_t jAbs)
+	{
+		const auto& ex = *_packed2;
+#ifdef COMPARE_PACKED
+		while (_exRun < ex.ExEnd.size () && ex.ExEnd [_exRun] <= jAbs) {
+			_exRun++;
+		}
+		const bool exception = _exRun < ex.ExEnd.size () && ex.ExBegin [_exRun] < jAbs + 50;
+		if (!_rowException && !exception) {
+			return COMPARE_PACKED (_rowCodes, _rowCase, ex.Bits, ex.Case, jAbs);
+		}
+#endif
+		ex.unpack (jAbs, 64, _window2);
+		return COMPARE (p1, _window2);
+	}
+
+	/*
+	 * Start of the record of gene2 after the one containing k.
+	 */
+	inline size_t nextRecord2 (const size_t k) const
+	{
+		const Sequence& gene2 = _inputs.Seq2;
+		const size_t r = gene2.findRecord (k) + 1;
+		return r < gene2.records () ? gene2.RecordStart [r] : -1;
+	}
+
+	inline void reportHit (const size_t i, const size_t j, const int score)
+	{
+		Result hit (i, _inputs.ReverseStrand);
+		hit.improve (j, score);
+		if (_sample) {
+			_sample->push_back (hit);
+		} else {
+			_sink->add (hit);
+		}
 	}
 
 	inline void solveForI (const size_t i, Result& best)
 	{
 		//cout << "solve for i = " << i << endl;
 
-		const uint8_t* const p1 = &(g1[i]);
-		for (size_t j = 0; j < len2; j++) {
+		const uint8_t* const p1 = _packed1 ? beginPackedRow (i) : &(g1[i - _g1Base]);
+		if (_groups2 && ++_rowStamp == 0) {
+			fill (_cachedRow.begin (), _cachedRow.end (), 0);
+			_rowStamp = 1;
+		}
+
+		if (_mask2) {
+			_maskRun = _mask2->findRun ((size_t) _origin + _jBegin);
+		}
+		_threshold = _results.threshold ();
+		if (_inputs.Batch) {
+			_batch.clear ();
+			_nextRecord2 = nextRecord2 ((size_t) _origin + _jBegin);
+		}
+
+		for (size_t j = _jBegin; j < _jEnd; j++) {
 			#if REQUIRE_SKIP_MAP
-				#if LOOKUP_STRATEGY == STRATEGY_MEMSET
-					if (_skip.isSkipped (i, j)) {
-						#if SKIPPING_STATS
-						_results.skippedVert++;
-						#endif
-						continue;
-					}
-				#else
-					if (!_skip.findUnskipped (i, j)) {
-						break;
-					}
+				#if SKIPPING_STATS
+				const size_t jPrev = j;
+				#endif
+				if (!_skip.findUnskipped (i, j) || j >= _jEnd) {
+					break;
+				}
+				#if SKIPPING_STATS
+				_results.skippedVert += j - jPrev;
 				#endif
 			#endif
 
@@ -74,19 +287,59 @@ public:
 			_results.notskipped++;
 			#endif
 
-			const uint8_t* const p2 = &(g2[j]);
-			int score = COMPARE (p1, p2);
+			const size_t jAbs = (size_t) _origin + j;
+			if (jAbs >= _nextRecord2) {
+				if (best.isValid ()) {
+					_batch.push_back (best);
+					best = Result (i, _inputs.ReverseStrand);
+				}
+				_nextRecord2 = nextRecord2 (jAbs);
+			}
+			if (_mask2) {
+				while (_maskRun < _mask2->End.size () && _mask2->End [_maskRun] <= jAbs) {
+					_maskRun++;
+				}
+				if (_maskRun < _mask2->End.size () && _mask2->Begin [_maskRun] <= jAbs) {
+					// continue after the run
+					j += _mask2->End [_maskRun] - jAbs - 1;
+					continue;
+				}
+			}
+
+			int score;
+			const uint32_t slot2 = _groups2 ? _groups2->Slot [jAbs] : WindowGroups::NO_SLOT;
+			if (slot2 != WindowGroups::NO_SLOT && _cachedRow [slot2] == _rowStamp) {
+				score = _cachedScore [slot2];
+			} else {
+				if (_packed2) {
+					score = comparePacked (p1, jAbs);
+				} else {
+					const uint8_t* const p2 = &(g2[jAbs]);
+					score = _matrix ? COMPARE_PROFILE (p1, p2, *_matrix) : COMPARE (p1, p2);
+				}
+				if (slot2 != WindowGroups::NO_SLOT) {
+					_cachedRow [slot2] = _rowStamp;
+					_cachedScore [slot2] = score;
+				}
+			}
 			//cout << "score of " << unsigned (i) << "," << unsigned (j) << " = " << unsigned (score) << endl;
-			if (score >= _inputs.Threshold) {
-				best.improve (j, score);
+			if (score >= _threshold) {
+				if (_inputs.Opts.AllHits) {
+					reportHit (i, _g2Base + jAbs, score);
+				} else {
+					best.improve (_g2Base + jAbs, score);
+				}
 				continue;
 			}
 
 			#if ENABLE_SKIPPING
-				int skip = (_inputs.Threshold - score - 1) / 3;
+				int skip = _matrix ? (_threshold - score - 1) / _maxDelta : (_threshold - score - 1) / 3;
 
 				#if REQUIRE_SKIP_MAP
 				_skip.skipRange (i, j, skip);
+				if (_inputs.AdaptiveSkipLimit) {
+					_tuner.record (skip);
+				}
 				#endif
 
 				if (skip > 0) {
@@ -98,26 +351,293 @@ public:
 			#endif
 		}
 
+		finishRow (i);
+	}
+
+	/*
+	 * Moves the band to row i.
+	 */
+	inline void beginRow (const size_t i)
+	{
+		if (!_band) {
+			return;
+		}
+		const int64_t origin = _band->origin (i);
+		if (origin != _origin) {
+			_skip.rebase (origin - _origin);
+			_origin = origin;
+		}
+
+		const int64_t end = (int64_t) len2 - origin;
+		_jBegin = origin < 0 ? min ((size_t) -origin, _width) : 0;
+		_jEnd = end <= 0 ? 0 : min ((size_t) end, _width);
+	}
+
+	inline void finishRow (const size_t i)
+	{
 		_skip.finishRow (i);
+		if (_inputs.AdaptiveSkipLimit && _tuner.finishRow (_skipLimit)) {
+			_skip.setLimit (_skipLimit);
+		}
 	}
 
-	inline void run ()
+	/*
+	 * Returns false if the row is not searched: either it is masked, or it is a duplicate of an earlier row whose
+	 * result is copied later on.
+	 */
+	inline bool solveRow (const size_t i, Result& best)
 	{
-		//cout << "thread " << threadId << "begins: " << endl;
-		size_t done = 0;
+		beginRow (i);
+		if ((_dups && _dups->isDuplicate (i)) || (_mask1 && _mask1->isMasked (i))) {
+			finishRow (i);
+			return false;
+		}
+		solveForI (i, best);
+		if (_dups) {
+			_dups->store (i, best);
+		}
+		return true;
+	}
+
+	/*
+	 * Continues with the rows [i0, i1), whose results are row block seq in ordered mode.
+	 * Skips only carry over to the next row, so they are dropped unless the block follows the previous one.
+	 */
+	inline void restart (const size_t i0, const size_t i1, const size_t seq)
+	{
+		if (i0 != _i1) {
+			// a shift by the full width drops everything
+			_skip.rebase ((int64_t) _width);
+			if (_band) {
+				_origin = _band->origin (i0);
+			}
+		}
+		_i0 = i0;
+		_i1 = i1;
+		if (_inputs.Opts.Ordered) {
+			_seq = seq;
+		}
+		if (_reverse) {
+			_reverse->restart (i0, i1, seq);
+		}
+	}
+
+	/*
+	 * Tile mode: continues with the next tile of gene2, whose skips have nothing to do with the previous one.
+	 */
+	inline void restart (const Chunk& tile2)
+	{
+		_skip.rebase ((int64_t) _width);
+		g2 = tile2.Data.data ();
+		len2 = tile2.Rows;
+		_g2Base = tile2.Start;
+		_jEnd = min (_width, len2);
+	}
+
+	inline void restart (const RowBlock& block)
+	{
+		restart (block.I0, block.I1, block.Seq);
+		g1 = block.rows ();
+		_g1Base = block.Source->Start;
+		if (_reverse) {
+			_reverse->g1 = g1;
+			_reverse->_g1Base = _g1Base;
+		}
+	}
+
+	/*
+	 * Solves row i on both strands if enabled and passes its results to report. The reverse strand follows right
+	 * after the forward one, while the row's window of gene1 is still in the cache.
+	 */
+	template <class Report>
+	inline void solveStrands (const size_t i, Report report)
+	{
+		Result best (i);
+		if (solveRow (i, best)) {
+			for (auto& r : _batch) {
+				report (r);
+			}
+			report (best);
+		}
+		if (_reverse) {
+			Result reverse (i, true);
+			if (_reverse->solveRow (i, reverse)) {
+				for (auto& r : _reverse->_batch) {
+					report (r);
+				}
+				report (reverse);
+			}
+		}
+	}
+
+	/*
+	 * Lane mode: solves the rows [i0, i1), at most COMPARE_LANES of them, in the lanes of one COMPARE_ROWS call per
+	 * window of gene2 and passes their results to report in row order. Each row skips along its own columns as in
+	 * solveForI, a column is scored as long as one of the rows needs it. Masked rows are scored but never report.
+	 * Neither band, batch, duplicates, packing nor the reverse strand apply, so the columns are those of gene2.
+	 */
+	template <class Report>
+	inline void solveLanes (const size_t i0, const size_t i1, Report report)
+	{
+		const size_t n = i1 - i0;
+		const uint8_t* const p1 = &(g1[i0 - _g1Base]);
+		size_t next [COMPARE_LANES];
+		alignas(32) uint8_t scores [COMPARE_LANES];
+
+		_threshold = _results.threshold ();
+		_laneBest.clear ();
+		size_t j = _jEnd;
+		for (size_t k = 0; k < n; k++) {
+			_laneBest.push_back (Result (i0 + k));
+			_laneHits [k].clear ();
+			next [k] = _mask1 && _mask1->isMasked (i0 + k) ? _jEnd : _jBegin;
+			j = min (j, next [k]);
+		}
+		if (_mask2) {
+			_maskRun = _mask2->findRun (j);
+		}
 
+		while (j < _jEnd) {
+			if (_mask2) {
+				while (_maskRun < _mask2->End.size () && _mask2->End [_maskRun] <= j) {
+					_maskRun++;
+				}
+				if (_maskRun < _mask2->End.size () && _mask2->Begin [_maskRun] <= j) {
+					// every row continues after the run
+					j = _jEnd;
+					for (size_t k = 0; k < n; k++) {
+						next [k] = max (next [k], (size_t) _mask2->End [_maskRun]);
+						j = min (j, next [k]);
+					}
+					continue;
+				}
+			}
+
+			#if SKIPPING_STATS
+			_results.notskipped++;
+			#endif
+			COMPARE_ROWS (p1, &(g2[j]), scores);
+
+			/*
+			 * Rows that were still skipping got a score as well, which may let them skip further. Only rows whose
+			 * turn it was can hit, the others are known to score below the threshold here.
+			 */
+			size_t nextJ = _jEnd;
+			for (size_t k = 0; k < n; k++) {
+				const int score = scores [k];
+				if (score < _threshold) {
+					#if ENABLE_SKIPPING
+					next [k] = max (next [k], j + 1 + (_threshold - score - 1) / 3);
+					#else
+					next [k] = max (next [k], j + 1);
+					#endif
+				} else if (next [k] == j) {
+					if (_inputs.Opts.AllHits) {
+						_laneHits [k].push_back (Result (i0 + k));
+						_laneHits [k].back ().improve (_g2Base + j, score);
+					} else {
+						_laneBest [k].improve (_g2Base + j, score);
+					}
+					next [k] = j + 1;
+				}
+				nextJ = min (nextJ, next [k]);
+			}
+			j = nextJ;
+		}
+
+		for (size_t k = 0; k < n; k++) {
+			if (_mask1 && _mask1->isMasked (i0 + k)) {
+				continue;
+			}
+			for (auto& hit : _laneHits [k]) {
+				if (_sample) {
+					_sample->push_back (hit);
+				} else {
+					_sink->add (hit);
+				}
+			}
+			report (_laneBest [k]);
+		}
+	}
+
+	/*
+	 * Solves row i, or in lane mode the rows from i on that share its lanes, passes their results to report and
+	 * returns how many rows were solved.
+	 */
+	template <class Report>
+	inline size_t solveNext (const size_t i, Report report)
+	{
+		if (_inputs.Opts.Lanes) {
+			const size_t n = min ((size_t) COMPARE_LANES, _i1 - i);
+			solveLanes (i, i + n, report);
+			return n;
+		}
+		solveStrands (i, report);
+		return 1;
+	}
+
+	/*
+	 * Solves the thread's rows without reporting them, used to time the strategies.
+	 */
+	inline void solveAll (vector <Result>& res)
+	{
+		_sample = &res;
+		if (_reverse) {
+			_reverse->_sample = &res;
+		}
+		for (size_t i = _i0; i < _i1;) {
+			i += solveNext (i, [&res] (const Result& r) {
+				res.push_back (r);
+			});
+		}
+	}
+
+	/*
+	 * Solves the thread's rows for one tile and merges them into the best results so far.
+	 */
+	inline void mergeAll (vector <Result>& rows)
+	{
+		if (_inputs.Opts.Lanes) {
+			for (size_t i = _i0; i < _i1; i += COMPARE_LANES) {
+				solveLanes (i, min (i + COMPARE_LANES, _i1), [&rows] (const Result& r) {
+					rows [r.i ()].improve (r);
+				});
+			}
+			return;
+		}
 		for (size_t i = _i0; i < _i1; i++) {
 			Result best (i);
-			solveForI (i, best);
-			_results.add (best);
+			if (solveRow (i, best)) {
+				rows [i].improve (best);
+			}
+		}
+	}
+
+	/*
+	 * Searches the rows [_i0, _i1) and returns the first row not searched, which is _i1 unless the time budget ran out.
+	 */
+	inline size_t run ()
+	{
+		//cout << "thread " << threadId << "begins: " << endl;
+		size_t done = 0;
+		_out.begin (_seq, _i0, _i1);
 
-			if (++done >= 1000) {
+		size_t i = _i0;
+		while (i < _i1 && !_results.expired ()) {
+			const size_t n = solveNext (i, [this] (const Result& r) {
+				_out.add (r);
+			});
+			i += n;
+
+			if ((done += n) >= 1000) {
 				_results.complete (done);
 				done = 0;
 			}
 		}
 		_results.complete (done);
+		_out.flush ();
 		//cout << "thread finished: " << threadId << endl;
+		return i;
 	}
 };
 
@@ -127,25 +647,428 @@ SearchMgr::SearchMgr (
 	ofstream* const ofs)
 	:
 	_inputs (inputs),
-	_results (inputs, ofs)
+	_results (inputs, ofs),
+	_dups (inputs.Groups1 ? new DuplicateRows (*inputs.Groups1) : 0)
 {
 }
 
-void SearchMgr::run ()
+template <class Skipper>
+void SearchMgr::runThreads (const size_t i0)
 {
+	if (_inputs.Opts.Ordered) {
+		orderedThreads<Skipper> (i0);
+		return;
+	}
+	if (_inputs.Opts.TimeBudget > 0) {
+		budgetThreads<Skipper> (i0);
+		return;
+	}
 	vector <thread> threads;
-	size_t prev = 0;
+	vector <unique_ptr <SearchThread<Skipper>>> searches;
+	const size_t n = _inputs.Len1 - i0;
+	size_t prev = i0;
 	for (int i = 0; i < _inputs.ThreadCount; i++) {
-		size_t next = _inputs.Len1 * (i + 1) / _inputs.ThreadCount;
-		auto st = new SearchThread (i, prev, next, _inputs, _results);
-		threads.push_back (thread (st->run, st));
+		size_t next = i0 + n * (i + 1) / _inputs.ThreadCount;
+		searches.push_back (unique_ptr <SearchThread<Skipper>> (new SearchThread<Skipper> (i, prev, next, _inputs, _results, _dups.get ())));
+		threads.push_back (thread (&SearchThread<Skipper>::run, searches.back ().get ()));
 		prev = next;
 	}
 	for (auto& t : threads) {
 		t.join ();
 	}
+}
 
-	int hash = _results.resultHash;
+/*
+ * Threads take blocks of ORDERED_BLOCK_ROWS rows in turn, the writer puts their results back in order.
+ */
+template <class Skipper>
+void SearchMgr::orderedThreads (const size_t i0)
+{
+	atomic <size_t> nextBlock (0);
+	vector <thread> threads;
+	for (int i = 0; i < _inputs.ThreadCount; i++) {
+		threads.push_back (thread ([this, i, i0, &nextBlock] () {
+			SearchThread<Skipper> st (i, i0, i0, _inputs, _results, 0);
+			for (size_t k; i0 + (k = nextBlock++) * ORDERED_BLOCK_ROWS < _inputs.Len1;) {
+				const size_t first = i0 + k * ORDERED_BLOCK_ROWS;
+				st.restart (first, min (first + ORDERED_BLOCK_ROWS, _inputs.Len1), k);
+				st.run ();
+			}
+		}));
+	}
+	for (auto& t : threads) {
+		t.join ();
+	}
+}
+
+/*
+ * Block k of 2^bits in bit-reversed order: every prefix of the order is spread evenly, halving the gaps between the
+ * blocks taken so far with each power of two.
+ */
+static inline size_t spreadBlock (size_t k, const int bits)
+{
+	size_t b = 0;
+	for (int n = 0; n < bits; n++) {
+		b = (b << 1) | (k & 1);
+		k >>= 1;
+	}
+	return b;
+}
+
+/*
+ * Threads take blocks of BUDGET_BLOCK_ROWS rows in the order of spreadBlock () until the time budget runs out,
+ * then the rows searched are reported.
+ */
+template <class Skipper>
+void SearchMgr::budgetThreads (const size_t i0)
+{
+	const size_t blocks = (_inputs.Len1 - i0 + BUDGET_BLOCK_ROWS - 1) / BUDGET_BLOCK_ROWS;
+	int bits = 0;
+	while (((size_t) 1 << bits) < blocks) {
+		bits++;
+	}
+	atomic <size_t> next (0);
+	mutex lock;
+	vector <pair <size_t, size_t>> searched;
+	if (i0 > 0) {
+		searched.push_back (make_pair ((size_t) 0, i0));
+	}
+
+	vector <thread> threads;
+	for (int i = 0; i < _inputs.ThreadCount; i++) {
+		threads.push_back (thread ([this, i, i0, blocks, bits, &next, &lock, &searched] () {
+			SearchThread<Skipper> st (i, i0, i0, _inputs, _results, 0);
+			for (size_t k; (k = next++) < ((size_t) 1 << bits) && !_results.expired ();) {
+				const size_t b = spreadBlock (k, bits);
+				if (b >= blocks) {
+					continue;
+				}
+				const size_t first = i0 + b * BUDGET_BLOCK_ROWS;
+				st.restart (first, min (first + BUDGET_BLOCK_ROWS, _inputs.Len1), ResultBlock::NO_SEQ);
+				const size_t last = st.run ();
+				if (last > first) {
+					lock_guard <mutex> guard (lock);
+					searched.push_back (make_pair (first, last));
+				}
+			}
+		}));
+	}
+	for (auto& t : threads) {
+		t.join ();
+	}
+	reportCoverage (searched);
+}
+
+/*
+ * Every thread works through blocks of the stream until it ends.
+ */
+template <class Skipper>
+void SearchMgr::streamThreads ()
+{
+	vector <thread> threads;
+	for (int i = 0; i < _inputs.ThreadCount; i++) {
+		threads.push_back (thread ([this, i] () {
+			RowBlock block;
+			if (!_inputs.Stream1->nextBlock (block)) {
+				return;
+			}
+			SearchThread<Skipper> st (i, block.I0, block.I0, _inputs, _results, 0);
+			do {
+				st.restart (block);
+				st.run ();
+			} while (_inputs.Stream1->nextBlock (block));
+		}));
+	}
+	for (auto& t : threads) {
+		t.join ();
+	}
+}
+
+/*
+ * Searches all rows against one tile of gene2 after the other, the reader prefetches the next tile meanwhile.
+ * Every thread keeps its rows and its search, which moves on from tile to tile, so memory only depends on the tile
+ * size. Results are reported once the last tile is done.
+ */
+template <class Skipper>
+void SearchMgr::tileThreads ()
+{
+	const size_t len1 = _inputs.Len1;
+	vector <Result> rows;
+	rows.reserve (len1);
+	for (size_t i = 0; i < len1; i++) {
+		rows.push_back (Result (i));
+	}
+
+	size_t tiles = 0;
+	vector <unique_ptr <SearchThread<Skipper>>> searches;
+	for (shared_ptr <const Chunk> tile; (tile = _inputs.Tiles2->nextChunk ());) {
+		vector <thread> threads;
+		size_t prev = 0;
+		for (int t = 0; t < _inputs.ThreadCount; t++) {
+			size_t next = len1 * (t + 1) / _inputs.ThreadCount;
+			if (tiles == 0) {
+				searches.push_back (unique_ptr <SearchThread<Skipper>> (new SearchThread<Skipper> (t, prev, next, _inputs, _results, 0, tile.get ())));
+			} else {
+				searches [t]->restart (*tile);
+			}
+			SearchThread<Skipper>* const st = searches [t].get ();
+			threads.push_back (thread ([st, &rows] () {
+				st->mergeAll (rows);
+			}));
+			prev = next;
+		}
+		for (auto& t : threads) {
+			t.join ();
+		}
+		printf ("Tile %zu done: windows %zu to %zu of gene 2 (%.3f s)\n",
+		        ++tiles, tile->Start, tile->Start + tile->Rows, _inputs.Elapsed (false));
+	}
+
+	for (auto& r : rows) {
+		_results.add (r);
+	}
+	_results.complete (len1);
+}
+
+template <class Skipper>
+double SearchMgr::timeSample (const size_t n, vector <Result>& res)
+{
+	auto t0 = chrono::steady_clock::now ();
+	SearchThread<Skipper> st (0, 0, n, _inputs, _results, _dups.get ());
+	st.solveAll (res);
+	chrono::duration <double> dur = chrono::steady_clock::now () - t0;
+	return dur.count ();
+}
+
+double SearchMgr::timeSample (const int strategy, const size_t n, vector <Result>& res)
+{
+	switch (strategy) {
+	case STRATEGY_MEMSET:  return timeSample<Skipper_Memset>  (n, res);
+	case STRATEGY_DLLIST:  return timeSample<Skipper_DLList>  (n, res);
+	case STRATEGY_SLLIST:  return timeSample<Skipper_SLList>  (n, res);
+	case STRATEGY_AVXSET1: return timeSample<Skipper_AVXset1> (n, res);
+	case STRATEGY_AVXSET2: return timeSample<Skipper_AVXset2> (n, res);
+	}
+	assert (false);
+	return 0;
+}
+
+/*
+ * Times every strategy on the first rows and returns the fastest.
+ * The winner's rows are reported and need not be calculated again.
+ */
+int SearchMgr::autoTune (size_t& done)
+{
+	static const int candidates[] = {
+		STRATEGY_MEMSET, STRATEGY_DLLIST, STRATEGY_SLLIST,
+		STRATEGY_AVXSET1, STRATEGY_AVXSET2
+	};
+
+	const size_t n = min (_inputs.Len1, (size_t) AUTOTUNE_ROWS);
+	int best = LOOKUP_STRATEGY;
+	double bestTime = -1;
+	vector <Result> bestRes;
+
+	cout << "Auto-tuning skipper on " << n << " rows:" << endl;
+	for (int s : candidates) {
+		vector <Result> res;
+		res.reserve (n);
+		double t = timeSample (s, n, res);
+		printf ("\t%-8s %.4f s\n", strategyName (s), t);
+		if (bestTime < 0 || t < bestTime) {
+			best = s;
+			bestTime = t;
+			bestRes.swap (res);
+		}
+	}
+	cout << "Selected skipper: " << strategyName (best) << endl;
+
+	for (auto& r : bestRes) {
+		_results.add (r);
+	}
+	_results.flush ();
+	_results.complete (n);
+	done = n;
+	return best;
+}
+
+/*
+ * Full-length mode: threads take tiles of gene1 in turn and find the ends of alignments against all of gene2. The
+ * ends are then aligned best first, each against the pairs of the alignments accepted so far. An end whose score
+ * dropped goes back into the queue, unless it still beats every other end, and every accepted alignment adds the ends
+ * it hid.
+ */
+void SearchMgr::alignAll ()
+{
+	const size_t len1 = _inputs.Len1;
+	const size_t tiles = (len1 + FULL_TILE_ROWS - 1) / FULL_TILE_ROWS;
+	atomic <size_t> nextTile (0);
+	mutex lock;
+	priority_queue <AlignmentEnd> ends;
+
+	vector <thread> threads;
+	for (int t = 0; t < _inputs.ThreadCount; t++) {
+		threads.push_back (thread ([this, len1, tiles, &nextTile, &lock, &ends] () {
+			vector <AlignmentEnd> found;
+			for (size_t k; (k = nextTile++) < tiles;) {
+				const size_t r0 = k * FULL_TILE_ROWS;
+				const size_t r1 = min (r0 + FULL_TILE_ROWS, len1);
+				const size_t first = r0 > FULL_TILE_OVERLAP ? r0 - FULL_TILE_OVERLAP : 0;
+				found.clear ();
+				findAlignmentEnds (_inputs.Gene1 + first, r1 - first, r0 - first, _inputs.Gene2, _inputs.Len2,
+				                   _inputs.Threshold, found);
+
+				lock_guard <mutex> guard (lock);
+				for (auto& e : found) {
+					ends.push ({ e.Score, first + e.I, e.J });
+				}
+				_results.complete (r1 - r0);
+			}
+		}));
+	}
+	for (auto& t : threads) {
+		t.join ();
+	}
+	printf ("%zu alignment ends found in %.3f s\n", ends.size (), _inputs.Elapsed (false));
+
+	LocalAligner aligner (_inputs.Gene1, len1, _inputs.Gene2, _inputs.Len2);
+	LocalAlignment a;
+	vector <AlignmentEnd> hidden;
+	size_t accepted = 0;
+	while (!ends.empty ()) {
+		const AlignmentEnd e = ends.top ();
+		ends.pop ();
+		if (!aligner.align (e, a) || a.Score < _inputs.Threshold) {
+			continue;
+		}
+		if (!ends.empty () && a.Score < ends.top ().Score) {
+			ends.push ({ a.Score, e.I, e.J });
+			continue;
+		}
+		hidden.clear ();
+		aligner.accept (a, _inputs.Threshold, hidden);
+		for (auto& h : hidden) {
+			ends.push (h);
+		}
+		_results.add (a);
+		accepted++;
+	}
+	printf ("%zu non-overlapping alignments\n", accepted);
+}
+
+/*
+ * Writes the rows searched within the time budget, and the ones left that are not masked, as BED files of window
+ * starts next to the results.
+ */
+void SearchMgr::reportCoverage (vector <pair <size_t, size_t>>& searched)
+{
+	sort (searched.begin (), searched.end ());
+	vector <pair <size_t, size_t>> done;
+	size_t rows = 0;
+	for (auto& r : searched) {
+		rows += r.second - r.first;
+		if (!done.empty () && r.first == done.back ().second) {
+			done.back ().second = r.second;
+		} else {
+			done.push_back (r);
+		}
+	}
+
+	// the gaps between the rows done, less the masked rows, which a later run would not search either
+	vector <pair <size_t, size_t>> todo;
+	const WindowMask* const mask = _inputs.Mask1;
+	size_t k = 0;
+	size_t m = 0;
+	for (size_t d = 0; d <= done.size (); d++) {
+		const size_t end = d < done.size () ? done [d].first : _inputs.Len1;
+		while (k < end) {
+			while (mask && m < mask->Begin.size () && mask->End [m] <= k) {
+				m++;
+			}
+			if (mask && m < mask->Begin.size () && mask->Begin [m] <= k) {
+				k = min (end, mask->End [m]);
+				continue;
+			}
+			const size_t stop = mask && m < mask->Begin.size () ? min (end, mask->Begin [m]) : end;
+			todo.push_back (make_pair (k, stop));
+			k = stop;
+		}
+		if (d < done.size ()) {
+			k = done [d].second;
+		}
+	}
+
+	const string donePath = string (_inputs.Opts.OutPath) + ".done.bed";
+	const string todoPath = string (_inputs.Opts.OutPath) + ".todo.bed";
+	if (!writeRegions (donePath.c_str (), done, _inputs.Seq1) || !writeRegions (todoPath.c_str (), todo, _inputs.Seq1)) {
+		cout << "could not write " << donePath << " or " << todoPath << endl;
+	}
+	printf ("%s: %zu of %zu rows searched in %zu ranges, listed in %s, the rest in %s\n",
+	        rows < _inputs.Len1 ? "Time budget used up" : "Time budget kept",
+	        rows, _inputs.Len1, done.size (), donePath.c_str (), todoPath.c_str ());
+}
+
+void SearchMgr::search ()
+{
+	size_t i0 = 0;
+	int strategy = _inputs.Opts.Strategy;
+	if (strategy == STRATEGY_AUTO && (_inputs.Stream1 || _inputs.Tiles2)) {
+		strategy = LOOKUP_STRATEGY;
+		cout << "Auto-tuning needs both genes up front, using " << strategyName (strategy) << endl;
+	}
+	if (strategy == STRATEGY_AUTO && _inputs.Opts.Lanes) {
+		strategy = LOOKUP_STRATEGY;
+		cout << "Lane mode does not skip vertically, using " << strategyName (strategy) << endl;
+	}
+	if (strategy == STRATEGY_AUTO) {
+		strategy = autoTune (i0);
+	}
+
+	if (_inputs.Tiles2) {
+		switch (strategy) {
+		case STRATEGY_MEMSET:  tileThreads<Skipper_Memset>  (); break;
+		case STRATEGY_DLLIST:  tileThreads<Skipper_DLList>  (); break;
+		case STRATEGY_SLLIST:  tileThreads<Skipper_SLList>  (); break;
+		case STRATEGY_AVXSET1: tileThreads<Skipper_AVXset1> (); break;
+		case STRATEGY_AVXSET2: tileThreads<Skipper_AVXset2> (); break;
+		}
+	} else if (_inputs.Stream1) {
+		switch (strategy) {
+		case STRATEGY_MEMSET:  streamThreads<Skipper_Memset>  (); break;
+		case STRATEGY_DLLIST:  streamThreads<Skipper_DLList>  (); break;
+		case STRATEGY_SLLIST:  streamThreads<Skipper_SLList>  (); break;
+		case STRATEGY_AVXSET1: streamThreads<Skipper_AVXset1> (); break;
+		case STRATEGY_AVXSET2: streamThreads<Skipper_AVXset2> (); break;
+		}
+	} else {
+		switch (strategy) {
+		case STRATEGY_MEMSET:  runThreads<Skipper_Memset>  (i0); break;
+		case STRATEGY_DLLIST:  runThreads<Skipper_DLList>  (i0); break;
+		case STRATEGY_SLLIST:  runThreads<Skipper_SLList>  (i0); break;
+		case STRATEGY_AVXSET1: runThreads<Skipper_AVXset1> (i0); break;
+		case STRATEGY_AVXSET2: runThreads<Skipper_AVXset2> (i0); break;
+		}
+	}
+
+	if (_dups) {
+		_dups->replay (0, _inputs.Len1, [this] (Result& r) {
+			_results.add (r);
+		});
+	}
+}
+
+void SearchMgr::run ()
+{
+	if (_inputs.Opts.FullLength) {
+		alignAll ();
+	} else {
+		search ();
+	}
+
+	if (_results.top ()) {
+		printf ("Top %zu: threshold rose from %d to %d\n", _inputs.Opts.TopK, _inputs.Threshold, _results.threshold ());
+	}
+	int hash = _results.finish ();
 	printf ("Result hash: %08X (the regular hash of sox3 & sry is 6976F3E0)\n", hash);
 #if SKIPPING_STATS
 	cout << _results.notskipped << " not skipped, "
@@ -2,11 +2,14 @@
 #define SEARCHMGR_H
 
 #include <iostream>
+#include <vector>
+#include <memory>
 using namespace std;
 
 #include "settings.h"
 
 #include "Results.h"
+#include "WindowDedup.h"
 
 
 class SearchMgr
@@ -14,6 +17,32 @@ class SearchMgr
 private:
 	Input& _inputs;
 	ResultCollector _results;
+	unique_ptr <DuplicateRows> _dups;
+
+	template <class Skipper>
+	void runThreads (const size_t i0);
+
+	template <class Skipper>
+	void orderedThreads (const size_t i0);
+
+	template <class Skipper>
+	void budgetThreads (const size_t i0);
+
+	template <class Skipper>
+	void streamThreads ();
+
+	template <class Skipper>
+	void tileThreads ();
+
+	template <class Skipper>
+	double timeSample (const size_t n, vector <Result>& res);
+
+	double timeSample (const int strategy, const size_t n, vector <Result>& res);
+	int autoTune (size_t& done);
+	void reportCoverage (vector <pair <size_t, size_t>>& searched);
+
+	void search ();
+	void alignAll ();
 
 public:
 	SearchMgr (Input& inputs, ofstream* const ofs);
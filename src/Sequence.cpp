@@ -0,0 +1,247 @@
+#include <string.h>
+#include <immintrin.h>
+
+#include <iostream>
+#include <thread>
+
+#include "settings.h"
+#include "Sequence.h"
+#include "Gzip.h"
+#include "FastaParser.h"
+#include "MappedFile.h"
+
+
+static inline const char* findNewline (const char* p, const char* const end)
+{
+#ifdef __AVX2__
+	const __m256i nl = _mm256_set1_epi8 ('\n');
+	for (; p + 32 <= end; p += 32) {
+		uint32_t m = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (_mm256_loadu_si256 ((const __m256i*) p), nl));
+		if (m) {
+			return p + __builtin_ctz (m);
+		}
+	}
+#endif
+	while (p < end && *p != '\n') {
+		p++;
+	}
+	return p;
+}
+
+/*
+ * Walks the lines of [p, end), which must start at a line start.
+ * Calls seq (line, len) for sequence lines (without line break) and header (line, len) for header lines (without '>').
+ */
+template <class FSeq, class FHeader>
+static inline void forEachLine (const char* p, const char* const end, FSeq seq, FHeader header)
+{
+	while (p < end) {
+		const char* e = findNewline (p, end);
+		size_t n = e - p;
+		if (n > 0 && p [n - 1] == '\r') {
+			n--;
+		}
+		if (n > 0 && p [0] == '>') {
+			header (p + 1, n - 1);
+		} else {
+			seq (p, n);
+		}
+		p = e + 1;
+	}
+}
+
+Sequence::Sequence (const char* const path, const char fill, const int nThreads)
+	:
+	_buffer (),
+	Data (0),
+	Len (0),
+	FileSize (0),
+	Headers (),
+	Names (),
+	RecordStart (),
+	RecordEnd ()
+{
+	MappedFile file (path);
+	FileSize = file.Size;
+	const char* const begin = file.Data;
+	const char* const end = begin + file.Size;
+
+	if (isGzip (begin, file.Size)) {
+		loadGzip (path, fill, nThreads);
+		endRecords ();
+		_buffer.grow (Len + 50 + 32, Len, 64);
+		memset (_buffer.data () + Len, fill, 50 + 32);
+		Data = _buffer.data ();
+		return;
+	}
+
+	/*
+	 * Chunk boundaries are moved to line starts, so no line is split between threads.
+	 */
+	const int nChunks = max (1, min (nThreads, (int) (file.Size >> 20) + 1));
+	vector <const char*> bounds (nChunks + 1, end);
+	bounds [0] = begin;
+	for (int c = 1; c < nChunks; c++) {
+		const char* b = max (bounds [c - 1], begin + file.Size * c / nChunks);
+		if (b > begin && b [-1] != '\n') {
+			b = findNewline (b, end);
+			b = b < end ? b + 1 : end;
+		}
+		bounds [c] = b;
+	}
+
+	/*
+	 * Pass 1 counts the bases of every chunk and where its headers are.
+	 * Record gaps depend on what precedes them in earlier chunks, so they are placed once all counts are known.
+	 */
+	vector <size_t> counts (nChunks, 0);
+	vector <vector <pair <size_t, string>>> headers (nChunks);
+	vector <thread> threads;
+	for (int c = 0; c < nChunks; c++) {
+		threads.push_back (thread ([&, c] () {
+			size_t n = 0;
+			forEachLine (bounds [c], bounds [c + 1],
+				[&n] (const char*, size_t len) { n += len; },
+				[&headers, &n, c] (const char* line, size_t len) { headers [c].push_back (make_pair (n, string (line, len))); });
+			counts [c] = n;
+		}));
+	}
+	for (auto& t : threads) {
+		t.join ();
+	}
+	vector <size_t> offsets (nChunks, 0);
+	vector <vector <size_t>> gaps (nChunks);
+	for (int c = 0; c < nChunks; c++) {
+		offsets [c] = Len;
+		size_t seen = 0;
+		for (auto& h : headers [c]) {
+			Len += h.first - seen;
+			seen = h.first;
+			gaps [c].push_back (beginRecord (h.second, Len));
+			Len += gaps [c].back ();
+		}
+		Len += counts [c] - seen;
+	}
+	endRecords ();
+
+	/*
+	 * Add bonus space.
+	 * 50 for regular processing past the end of line.
+	 * 32 for worst case overhead from AVX processing.
+	 */
+	_buffer.reserve (Len + 50 + 32, 64);
+	uint8_t* const out = _buffer.data ();
+	memset (out + Len, fill, 50 + 32);
+
+	threads.clear ();
+	for (int c = 0; c < nChunks; c++) {
+		threads.push_back (thread ([&, c] () {
+			uint8_t* o = out + offsets [c];
+			size_t h = 0;
+			forEachLine (bounds [c], bounds [c + 1],
+				[&o] (const char* line, size_t len) { memcpy (o, line, len); o += len; },
+				[&, c] (const char*, size_t) { memset (o, fill, gaps [c][h]); o += gaps [c][h++]; });
+		}));
+	}
+	for (auto& t : threads) {
+		t.join ();
+	}
+
+	Data = out;
+}
+
+/*
+ * The size is not known in advance, so the buffer grows as the decompressed text arrives.
+ */
+void Sequence::loadGzip (const char* const path, const char fill, const int nThreads)
+{
+	unique_ptr <ByteSource> source = openSource (path, nThreads);
+	FastaParser parser;
+	vector <char> buf (GZIP_BLOCK_BYTES);
+	size_t capacity = 0;
+
+	auto reserve = [this, &capacity] (size_t n) {
+		if (Len + n > capacity) {
+			capacity = max (2 * capacity, Len + n + GZIP_BLOCK_BYTES);
+			_buffer.grow (capacity, Len, 64);
+		}
+	};
+	auto header = [this, fill, &reserve] (const string& line) {
+		const size_t gap = beginRecord (line, Len);
+		reserve (gap);
+		memset (_buffer.data () + Len, fill, gap);
+		Len += gap;
+	};
+	for (size_t got; (got = source->read (buf.data (), buf.size ())) > 0;) {
+		parser.feed (buf.data (), buf.data () + got,
+			[this, &reserve] (const char* p, size_t n) {
+				reserve (n);
+				memcpy (_buffer.data () + Len, p, n);
+				Len += n;
+			},
+			header);
+	}
+	parser.finish (header);
+}
+
+/*
+ * Ends the current record at pos and starts the one of the given header, returns the gap to write in between.
+ * Leading headers without any bases before them need no gap.
+ */
+size_t Sequence::beginRecord (const string& header, const size_t pos)
+{
+	if (RecordStart.empty () && pos > 0) {
+		Names.push_back ("");
+		RecordStart.push_back (0);
+	}
+	if (!RecordStart.empty ()) {
+		RecordEnd.push_back (pos);
+	}
+	const size_t gap = pos > 0 ? RecordGap : 0;
+	Headers.push_back (header);
+	Names.push_back (header.substr (0, header.find_first_of (" \t")));
+	RecordStart.push_back (pos + gap);
+	return gap;
+}
+
+void Sequence::endRecords ()
+{
+	if (RecordStart.empty ()) {
+		Names.push_back ("");
+		RecordStart.push_back (0);
+	}
+	RecordEnd.push_back (Len);
+}
+
+unique_ptr <Sequence> Sequence::reverseComplement () const
+{
+	uint8_t complement [256];
+	for (int c = 0; c < 256; c++) {
+		complement [c] = c;
+	}
+	const char* const from = "ACGTacgt";
+	const char* const to = "TGCAtgca";
+	for (int k = 0; k < 8; k++) {
+		complement [(uint8_t) from [k]] = to [k];
+	}
+
+	unique_ptr <Sequence> rc (new Sequence ());
+	if (Data) {
+		rc->_buffer.reserve (Len + 50 + 32, 64);
+		uint8_t* const out = rc->_buffer.data ();
+		for (size_t k = 0; k < Len; k++) {
+			out [k] = complement [Data [Len - 1 - k]];
+		}
+		memcpy (out + Len, Data + Len, 50 + 32);
+		rc->Data = out;
+	}
+	rc->Len = Len;
+	rc->FileSize = FileSize;
+	rc->Headers = Headers;
+	for (size_t r = records (); r-- > 0;) {
+		rc->Names.push_back (Names [r]);
+		rc->RecordStart.push_back (Len - RecordEnd [r]);
+		rc->RecordEnd.push_back (Len - RecordStart [r]);
+	}
+	return rc;
+}
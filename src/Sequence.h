@@ -0,0 +1,129 @@
+#ifndef SEQUENCE_H_INCLUDED
+#define SEQUENCE_H_INCLUDED
+
+#include <stdint.h>
+#include <algorithm>
+#include <memory>
+#include <string>
+#include <vector>
+using namespace std;
+
+#include "Ators.h"
+
+
+/*
+ * A FASTA file loaded into one aligned buffer, with headers and line breaks removed.
+ *
+ * The file is memory mapped and split into line-aligned chunks that are stripped in parallel: a first pass counts
+ * the sequence bytes of every chunk, a second pass copies each chunk straight to its final offset.
+ * Gzip files are decompressed on other threads while the output is stripped, see GzipSource.
+ * The buffer is followed by 50 + 32 fill bytes, so windows and AVX loads may run past the last base.
+ * Records are separated by RecordGap fill bytes, so no window covers bases of two records.
+ * Everything else refers to the data through Data and Len and never copies it.
+ */
+class Sequence
+{
+private:
+	AlignedBuffer _buffer;
+
+	void loadGzip (const char* const path, const char fill, const int nThreads);
+	size_t beginRecord (const string& header, const size_t pos);
+	void endRecords ();
+
+public:
+	static const size_t RecordGap = 50;
+
+	/*
+	 * Fill bytes of file 1 and file 2, which never match each other or a base
+	 */
+	static const char Fill1 = '1';
+	static const char Fill2 = '2';
+
+	const uint8_t* Data;
+	size_t Len;
+	size_t FileSize;
+
+	/*
+	 * Header lines without the leading '>', in file order
+	 */
+	vector <string> Headers;
+
+	/*
+	 * Record r covers [RecordStart [r], RecordEnd [r]) and is named by the first word of its header.
+	 * Bases before the first header (or a file without headers) form a record with an empty name.
+	 */
+	vector <string> Names;
+	vector <size_t> RecordStart;
+	vector <size_t> RecordEnd;
+
+	/*
+	 * An empty sequence
+	 */
+	inline Sequence ()
+		:
+		_buffer (),
+		Data (0),
+		Len (0),
+		FileSize (0),
+		Headers (),
+		Names (),
+		RecordStart (),
+		RecordEnd ()
+	{
+	}
+
+	/*
+	 * A view of len bases (and the fill behind them) owned by someone else, the record table is filled in by the caller.
+	 */
+	inline Sequence (const uint8_t* const data, const size_t len, const size_t fileSize)
+		:
+		_buffer (),
+		Data (data),
+		Len (len),
+		FileSize (fileSize),
+		Headers (),
+		Names (),
+		RecordStart (),
+		RecordEnd ()
+	{
+	}
+
+	/*
+	 * Exits the program if the file cannot be read.
+	 */
+	Sequence (const char* const path, const char fill, const int nThreads);
+
+	/*
+	 * The reverse complement, with its own copy of the data. The records come in reverse order, so record r here is
+	 * record records () - 1 - r of this sequence. Bytes other than ACGT (in either case) are kept as they are.
+	 * Without data, only the record table is reversed.
+	 */
+	unique_ptr <Sequence> reverseComplement () const;
+
+	/*
+	 * Frees the data once it is no longer needed, Len, FileSize and the record table remain valid.
+	 */
+	inline void release ()
+	{
+		_buffer = AlignedBuffer ();
+		Data = 0;
+	}
+
+	inline size_t records () const
+	{
+		return RecordStart.size ();
+	}
+
+	/*
+	 * The record containing position k, or the record before the gap k lies in.
+	 */
+	inline size_t findRecord (const size_t k) const
+	{
+		return upper_bound (RecordStart.begin (), RecordStart.end (), k) - RecordStart.begin () - 1;
+	}
+
+	Sequence (const Sequence&) = delete;
+	Sequence& operator = (const Sequence&) = delete;
+};
+
+#endif // SEQUENCE_H_INCLUDED
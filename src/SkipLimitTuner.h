@@ -0,0 +1,86 @@
+#ifndef SKIPLIMITTUNER_H_INCLUDED
+#define SKIPLIMITTUNER_H_INCLUDED
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+using namespace std;
+
+#include "settings.h"
+
+
+/*
+ * Chooses the vertical skip limit from the skip distances seen so far.
+ *
+ * A skip of s at (i, j) covers the positions j - (s - d) .. j + (s - d) in row i + d, for d = 1 .. s.
+ * Summing these widths over all recorded skips tells how many positions each row offset d could save.
+ * The limit is the smallest d that covers ADAPTIVE_SKIP_COVERAGE of the total.
+ */
+class SkipLimitTuner
+{
+private:
+	const int _maxLimit;
+	uint32_t _hist [MAX_VERTICAL_SKIP_LIMIT + 2];
+	int _rows;
+
+public:
+	inline SkipLimitTuner (const int maxLimit)
+		:
+		_maxLimit (maxLimit),
+		_rows (0)
+	{
+		memset (_hist, 0, sizeof (_hist));
+	}
+
+	inline void record (const int skip)
+	{
+		if (skip > 0) {
+			_hist [min (skip, _maxLimit + 1)]++;
+		}
+	}
+
+	/*
+	 * Call once per row. Returns true if the limit should be changed to the new value.
+	 */
+	inline bool finishRow (int& limit)
+	{
+		if (++_rows < ADAPTIVE_SKIP_INTERVAL) {
+			return false;
+		}
+		_rows = 0;
+
+		double mass [MAX_VERTICAL_SKIP_LIMIT + 2] = {0};
+		double total = 0;
+		for (int s = 1; s <= _maxLimit + 1; s++) {
+			for (int d = 1; d <= s && d <= _maxLimit; d++) {
+				double m = 1.0 * _hist [s] * (2 * (s - d) + 1);
+				mass [d] += m;
+				total += m;
+			}
+			// Older rows count less, so the limit follows changes along the input.
+			_hist [s] /= 2;
+		}
+		if (total <= 0) {
+			return false;
+		}
+
+		int next = _maxLimit;
+		double covered = 0;
+		for (int d = 1; d <= _maxLimit; d++) {
+			covered += mass [d];
+			if (covered >= ADAPTIVE_SKIP_COVERAGE * total) {
+				next = d;
+				break;
+			}
+		}
+
+		if (next == limit) {
+			return false;
+		}
+		limit = next;
+		return true;
+	}
+};
+
+
+#endif // SKIPLIMITTUNER_H_INCLUDED
@@ -1,23 +1,56 @@
 #ifndef SKIPPER_H_INCLUDED
 #define SKIPPER_H_INCLUDED
 
+#include <string.h>
+#include <string>
+using namespace std;
+
 #include "settings.h"
+#include "Ators.h"
+
+#include "Skipper_Memset.h"
+#include "Skipper_DLList.h"
+#include "Skipper_SLList.h"
+#include "Skipper_AVXset.h"
+#include "Skipper_AVXset2.h"
+
+
+/*
+ * All strategies are compiled in. They share the following interface and are plugged into the search as a template
+ * parameter, so the per-cell calls are resolved statically:
+ *
+ * skipRange (i, j, skip)    position (i, j) scored `skip` steps below the threshold
+ * findUnskipped (i, j)      advance j to the next position of row i that must be calculated, false if there is none
+ * finishRow (i)             row i is done, prepare the lookup for the following rows
+ */
+
+inline const char* strategyName (const int strategy)
+{
+	return strategy == STRATEGY_MEMSET  ? "memset"
+	     : strategy == STRATEGY_DLLIST  ? "dllist"
+	     : strategy == STRATEGY_SLLIST  ? "sllist"
+	     : strategy == STRATEGY_AVXSET1 ? "avxset1"
+	     : strategy == STRATEGY_AVXSET2 ? "avxset2"
+	     : strategy == STRATEGY_AUTO    ? "auto"
+	     : "none";
+}
 
-#if REQUIRE_SKIP_MAP
-	#if LOOKUP_STRATEGY == STRATEGY_MEMSET
-		#include "Skipper_Memset.h"
-	#elif LOOKUP_STRATEGY == STRATEGY_DLLIST
-		#include "Skipper_DLList.h"
-	#elif LOOKUP_STRATEGY == STRATEGY_SLLIST
-		#include "Skipper_SLList.h"
-	#elif LOOKUP_STRATEGY == STRATEGY_AVXSET1
-		#include "Skipper_AVXset.h"
-	#elif LOOKUP_STRATEGY == STRATEGY_AVXSET2
-		#include "Skipper_AVXset2.h"
-	#else
-		#error Unknown skipping strategy
-	#endif
-#endif
+/*
+ * Returns -1 if the name is unknown.
+ */
+inline int strategyFromName (const char* const name)
+{
+	static const int all[] = {
+		STRATEGY_MEMSET, STRATEGY_DLLIST, STRATEGY_SLLIST,
+		STRATEGY_AVXSET1, STRATEGY_AVXSET2, STRATEGY_AUTO
+	};
+	for (int s : all) {
+		if (strcmp (name, strategyName (s)) == 0) {
+			return s;
+		}
+	}
+	return -1;
+}
 
 
 #endif // SKIPPER_H_INCLUDED
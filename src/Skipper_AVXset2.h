@@ -7,29 +7,31 @@
 #include "avx_util.h"
 
 
-static const __m256i plus_1 = _mm256_set1_epi8 (1);
-
-static const __m256i V_15_0_16 = _mm256_setr_epi8 (
-	15, 14, 13, 12, 11, 10, 9, 8,
-	7, 6, 5, 4, 3, 2, 1, 0,
-	1, 2, 3, 4, 5, 6, 7, 8,
-	9, 10, 11, 12, 13, 14, 15, 16);
-
 /*
  * Similar to the single line node skipper (SLList), but without nodes.
  * Instead we store all possible nodes in an array and operate on it with SIMD.
  */
-class Skipper
+class Skipper_AVXset2
 {
 private:
 	const size_t _len2;
+	AlignedBuffer _buffer;
 	uint8_t* const avoid;
 
 public:
-	inline Skipper (const size_t len2)
+	inline Skipper_AVXset2 (const size_t len2, __attribute__((unused)) const int limit)
 		:
 		_len2 (len2),
-		avoid (persisting_malloc_align (16 + len2 + sizeof(__m256i), 64))
+		_buffer (),
+		// 16 guard bytes in front, as positions up to j - 15 are accessed
+		avoid (16 + _buffer.zeroed (16 + len2 + 2 * sizeof(__m256i), 64))
+	{
+	}
+
+	/*
+	 * The vertical range is implied by the stored skip values, there is no separate limit.
+	 */
+	inline void setLimit (__attribute__((unused)) const int limit)
 	{
 	}
 
@@ -62,10 +64,21 @@ public:
 		_mm256_storeu_si256 (p, r0);
 	}
 
+	/*
+	 * The band moved by delta positions, so local position k + delta becomes k.
+	 * Values that spilled over either end are dropped.
+	 */
+	inline void rebase (const int64_t delta)
+	{
+		memset (avoid - 16, 0, 16);
+		memset (avoid + _len2, 0, 2 * sizeof(__m256i));
+		shift_bytes (avoid, _len2, delta);
+	}
+
 	inline void finishRow (__attribute__((unused)) const size_t row_i)
 	{
-		for (size_t k = 0; k <= _len2 / sizeof(__m256i); k++) {
-			__m256i* p = (__m256i*) & (avoid [k * sizeof(__m256i)]);
+		for (size_t k = 0; k <= (_len2 + 16) / sizeof(__m256i); k++) {
+			__m256i* p = (__m256i*) & (avoid [k * sizeof(__m256i) - 16]);
 			__m256i r = _mm256_loadu_si256 (p);
 			r = _mm256_subs_epu8 (r, plus_1);
 			_mm256_storeu_si256 (p, r);
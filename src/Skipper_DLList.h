@@ -1,6 +1,8 @@
 #ifndef SKIPPER_DLLIST_H_INCLUDED
 #define SKIPPER_DLLIST_H_INCLUDED
 
+#include <vector>
+
 #include "settings.h"
 #include "BitmapNode.h"
 
@@ -17,7 +19,7 @@ public:
 	inline SkipRow (const size_t len2, IAllocator<BitmapNode>& ator)
 		:
 		_len2 (len2),
-		_Root (new BitmapNode (len2)),
+		_Root (new(ator.alloc ()) BitmapNode (len2)),
 		_Cursor (_Root),
 		_Ator (ator)
 	{
@@ -75,13 +77,14 @@ public:
 	}
 };
 
-class Skipper
+class Skipper_DLList
 {
 private:
 	const size_t _len2;
-	const int _nRows;
-	SkipRow** const _rows;
-	IAllocator<BitmapNode>* const _Ator;
+	int _limit;
+	int _nRows;
+	unique_ptr <IAllocator<BitmapNode>> _Ator;
+	vector <unique_ptr <SkipRow>> _rows;
 
 	inline size_t getLookupIndex (const int index)
 	{
@@ -97,21 +100,39 @@ private:
 	}
 
 public:
-	inline Skipper (const size_t len2)
+	inline Skipper_DLList (const size_t len2, const int limit)
 		:
 		_len2 (len2),
-		_nRows (1 + VERTICAL_SKIP_LIMIT),
-		_rows (new SkipRow* [_nRows]),
-		_Ator (new BitmapNode_Ator_Q ())
+		_limit (-1),
+		_nRows (0),
+		_Ator (new BitmapNode_Ator_Q ()),
+		_rows ()
+	{
+		setLimit (limit);
+	}
+
+	/*
+	 * Changes the number of rows below the current one that receive skips.
+	 * Pending skips are dropped, which only means that some positions are calculated after all.
+	 */
+	inline void setLimit (const int limit)
 	{
+		if (limit == _limit) {
+			return;
+		}
+		_limit = limit;
+		_nRows = 1 + limit;
+		while ((int) _rows.size () < _nRows) {
+			_rows.push_back (unique_ptr <SkipRow> (new SkipRow (_len2, *_Ator)));
+		}
 		for (int i = 0; i < _nRows; i++) {
-			_rows [i] = new SkipRow (len2, *_Ator);
+			_rows [i]->clear ();
 		}
 	}
 
 	inline void skipRange (size_t i, size_t j, int skip)
 	{
-		for (int di = 1; di <= VERTICAL_SKIP_LIMIT; di++) {
+		for (int di = 1; di <= _limit; di++) {
 			skip--;
 			if (skip < 0) {
 				break;
@@ -120,7 +141,7 @@ public:
 			int effI = i + di;
 			SkipRow& pArray = getSkips (effI);
 
-			size_t j0 = max (j - skip, (size_t)0);
+			size_t j0 = j > (size_t) skip ? j - skip : 0;
 			size_t j1 = min (j + skip, _len2 - 1);
 			pArray.skip (j0, j1);
 		}
@@ -133,6 +154,17 @@ public:
 		return res;
 	}
 
+	/*
+	 * The band moved by delta positions, so local position k + delta becomes k.
+	 * The lists are not moved but reset, which only drops pending skips.
+	 */
+	inline void rebase (__attribute__((unused)) const int64_t delta)
+	{
+		for (int i = 0; i < _nRows; i++) {
+			_rows [i]->clear ();
+		}
+	}
+
 	inline void finishRow (const size_t row_i)
 	{
 		for (int i = 0; i < _nRows; i++) {
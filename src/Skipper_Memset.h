@@ -4,12 +4,14 @@
 #include "settings.h"
 
 
-class Skipper
+class Skipper_Memset
 {
 private:
 	const size_t _len2;
-	const int _nRows;
-	uint8_t* const avoid;
+	int _limit;
+	int _nRows;
+	AlignedBuffer _buffer;
+	uint8_t* avoid;
 
 	inline size_t getLookupIndex (const int index) const
 	{
@@ -27,22 +29,41 @@ private:
 	inline uint8_t* getSkips (const int index)
 	{
 		return const_cast <uint8_t*> (
-			static_cast <const Skipper &> (*this)
+			static_cast <const Skipper_Memset &> (*this)
 			.getSkips (index));
 	}
 
 public:
-	inline Skipper (size_t len2)
+	inline Skipper_Memset (const size_t len2, const int limit)
 		:
 		_len2 (len2),
-		_nRows (1 + VERTICAL_SKIP_LIMIT),
-		avoid (persisting_malloc_align (_nRows * len2, 64))
+		_limit (-1),
+		_nRows (0),
+		_buffer (),
+		avoid (0)
 	{
+		setLimit (limit);
+	}
+
+	/*
+	 * Changes the number of rows below the current one that receive skips.
+	 * Pending skips are dropped, which only means that some positions are calculated after all.
+	 */
+	inline void setLimit (const int limit)
+	{
+		if (limit == _limit) {
+			return;
+		}
+		_limit = limit;
+		_nRows = 1 + limit;
+		_buffer.reserve (_nRows * _len2, 64);
+		avoid = _buffer.data ();
+		memset (avoid, 0, _nRows * _len2);
 	}
 
 	inline void skipRange (const size_t i, size_t j, int skip)
 	{
-		for (int di = 1; di <= VERTICAL_SKIP_LIMIT; di++) {
+		for (int di = 1; di <= _limit; di++) {
 			skip--;
 			if (skip < 0) {
 				break;
@@ -51,7 +72,7 @@ public:
 			int effI = i + di;
 			uint8_t* const pArray = getSkips (effI);
 
-			size_t j0 = max (j - skip, (size_t)0);
+			size_t j0 = j > (size_t) skip ? j - skip : 0;
 			size_t j1 = min (j + skip, _len2 - 1);
 
 			#if 0
@@ -75,6 +96,25 @@ public:
 		return (bool) skipJ;
 	}
 
+	inline bool findUnskipped (const size_t i, size_t& j) const
+	{
+		const uint8_t* const mySkips = getSkips (i);
+		while (j < _len2 && mySkips[j]) {
+			j++;
+		}
+		return j < _len2;
+	}
+
+	/*
+	 * The band moved by delta positions, so local position k + delta becomes k.
+	 */
+	inline void rebase (const int64_t delta)
+	{
+		for (int r = 0; r < _nRows; r++) {
+			shift_bytes (&(avoid [r * _len2]), _len2, delta);
+		}
+	}
+
 	inline void finishRow (const size_t row_i)
 	{
 		uint8_t* const mySkips = getSkips (row_i);
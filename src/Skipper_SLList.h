@@ -4,15 +4,15 @@
 #include "settings.h"
 #include "ForwardDottedLookupList.h"
 
-class Skipper
+class Skipper_SLList
 {
 private:
 	const size_t _len2;
-	IAllocator<FDLL_Node>* const _Ator;
+	unique_ptr <IAllocator<FDLL_Node>> _Ator;
 	ForwardDottedLookupList _FDLL;
 
 public:
-	inline Skipper (const size_t len2)
+	inline Skipper_SLList (const size_t len2, __attribute__((unused)) const int limit)
 		:
 		_len2 (len2),
 		_Ator (new Allocator_Q<FDLL_Node> ()),
@@ -20,6 +20,13 @@ public:
 	{
 	}
 
+	/*
+	 * The vertical range is implied by the stored skip values, there is no separate limit.
+	 */
+	inline void setLimit (__attribute__((unused)) const int limit)
+	{
+	}
+
 	inline void skipRange (__attribute__((unused)) const size_t i, const size_t j, int skip)
 	{
 		skip--;
@@ -27,15 +34,24 @@ public:
 			return;
 		}
 
-		size_t j0 = max (j - skip, (size_t)0);
+		size_t j0 = j > (size_t) skip ? j - skip : 0;
 		size_t j1 = min (j + skip, _len2 - 1);
 		_FDLL.skip (j0, j1);
 	}
 
+	/*
+	 * The band moved by delta positions, so local position k + delta becomes k.
+	 */
+	inline void rebase (const int64_t delta)
+	{
+		_FDLL.shift (delta);
+	}
+
 	inline void finishRow (__attribute__((unused)) const size_t row_i)
 	{
-		_FDLL.resetCursor ();
+		// nextRow may free the old root, so the cursor is reset afterwards
 		_FDLL.nextRow ();
+		_FDLL.resetCursor ();
 	}
 
 	inline bool findUnskipped (__attribute__((unused)) const size_t i, size_t& j)
@@ -0,0 +1,178 @@
+#include <stdlib.h>
+#include <string.h>
+#include <iostream>
+
+#include "Stream.h"
+#include "FastaParser.h"
+#include "settings.h"
+
+
+static const size_t OVERLAP = 49;
+static const size_t FILL = 50 + 32;
+static const size_t READ_SIZE = 1 << 20;
+
+ChunkStream::ChunkStream (const char* const path, const size_t chunkRows, const int nThreads, const char fill)
+	:
+	_source (openSource (path, nThreads)),
+	_path (path),
+	_chunkRows (chunkRows),
+	_blockRows ((chunkRows + nThreads - 1) / nThreads),
+	_fill (fill),
+	_lock (),
+	_changed (),
+	_queue (),
+	_eof (false),
+	_len (0),
+	_chunks (0),
+	_current (),
+	_nextRow (0),
+	_blocks (0),
+	_reader ()
+{
+	_reader = thread (&ChunkStream::read, this);
+}
+
+ChunkStream::~ChunkStream ()
+{
+	_reader.join ();
+}
+
+/*
+ * Queues a chunk, waiting while the queue is full, and starts the next one with the overlap.
+ */
+void ChunkStream::push (shared_ptr <Chunk>& chunk)
+{
+	shared_ptr <Chunk> next (new Chunk ());
+	const size_t n = chunk->Data.size ();
+	const size_t keep = min (n, OVERLAP);
+	next->Start = chunk->Start + n - keep;
+	next->Data.reserve (_chunkRows + OVERLAP + FILL);
+	next->Data.insert (next->Data.end (), chunk->Data.end () - keep, chunk->Data.end ());
+
+	chunk->Rows = n - keep;
+	chunk->Data.resize (n + FILL, _fill);
+
+	unique_lock <mutex> lock (_lock);
+	_changed.wait (lock, [this] { return _queue.size () < STREAM_QUEUE_CHUNKS; });
+	_queue.push_back (chunk);
+	_chunks++;
+	_changed.notify_all ();
+	lock.unlock ();
+
+	chunk = next;
+}
+
+void ChunkStream::read ()
+{
+	vector <char> buf (READ_SIZE);
+	shared_ptr <Chunk> chunk (new Chunk ());
+	chunk->Start = 0;
+	chunk->Data.reserve (_chunkRows + OVERLAP + FILL);
+
+	FastaParser parser;
+	size_t len = 0;
+	bool named = false;
+
+	/*
+	 * A header after bases or after another header starts a second record.
+	 */
+	auto header = [this, &len, &named] (const string& line) {
+		if (named || len > 0) {
+			cout << "--stream and --tile-size need a single record, "
+			     << (strcmp (_path, "-") == 0 ? "stdin" : _path) << " has several" << endl;
+			exit (2);
+		}
+		named = true;
+		cout << '>' << line << endl;
+	};
+	for (size_t got; (got = _source->read (buf.data (), buf.size ())) > 0;) {
+		parser.feed (buf.data (), buf.data () + got,
+			[this, &chunk, &len] (const char* p, size_t n) {
+				len += n;
+				while (n > 0) {
+					const size_t k = min (n, _chunkRows + OVERLAP - chunk->Data.size ());
+					chunk->Data.insert (chunk->Data.end (), p, p + k);
+					p += k;
+					n -= k;
+					if (chunk->Data.size () == _chunkRows + OVERLAP) {
+						push (chunk);
+					}
+				}
+			},
+			header);
+		lock_guard <mutex> lock (_lock);
+		_len = len;
+	}
+	parser.finish (header);
+
+	/*
+	 * The last chunk holds all remaining rows, their windows run into the fill like those of a loaded file.
+	 */
+	if (chunk->Data.size () > 0) {
+		const size_t n = chunk->Data.size ();
+		chunk->Rows = n;
+		chunk->Data.resize (n + FILL, _fill);
+		unique_lock <mutex> lock (_lock);
+		_changed.wait (lock, [this] { return _queue.size () < STREAM_QUEUE_CHUNKS; });
+		_queue.push_back (chunk);
+		_chunks++;
+	}
+
+	lock_guard <mutex> lock (_lock);
+	_len = len;
+	_eof = true;
+	_changed.notify_all ();
+}
+
+bool ChunkStream::nextBlock (RowBlock& block)
+{
+	unique_lock <mutex> lock (_lock);
+
+	// another worker may have taken the next chunk while this one was waiting
+	while (!_current || _nextRow >= _current->Start + _current->Rows) {
+		if (!_queue.empty ()) {
+			_current = _queue.front ();
+			_queue.pop_front ();
+			_nextRow = _current->Start;
+			_changed.notify_all ();
+		} else if (_eof) {
+			_current.reset ();
+			return false;
+		} else {
+			_current.reset ();
+			_changed.wait (lock);
+		}
+	}
+
+	block.Source = _current;
+	block.I0 = _nextRow;
+	block.I1 = min (_nextRow + _blockRows, _current->Start + _current->Rows);
+	block.Seq = _blocks++;
+	_nextRow = block.I1;
+	return true;
+}
+
+shared_ptr <const Chunk> ChunkStream::nextChunk ()
+{
+	unique_lock <mutex> lock (_lock);
+	_changed.wait (lock, [this] { return !_queue.empty () || _eof; });
+	if (_queue.empty ()) {
+		return shared_ptr <const Chunk> ();
+	}
+	shared_ptr <const Chunk> chunk = _queue.front ();
+	_queue.pop_front ();
+	_changed.notify_all ();
+	return chunk;
+}
+
+size_t ChunkStream::length ()
+{
+	lock_guard <mutex> lock (_lock);
+	return _len;
+}
+
+size_t ChunkStream::chunks ()
+{
+	lock_guard <mutex> lock (_lock);
+	return _chunks;
+}
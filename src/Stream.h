@@ -0,0 +1,114 @@
+#ifndef STREAM_H_INCLUDED
+#define STREAM_H_INCLUDED
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <condition_variable>
+using namespace std;
+
+#include "Gzip.h"
+
+
+/*
+ * A piece of gene1: the bases [Start, Start + Rows + 49), followed by fill.
+ * Windows starting at Start .. Start + Rows - 1 lie completely inside.
+ */
+class Chunk
+{
+public:
+	size_t Start;
+	size_t Rows;
+	vector <uint8_t> Data;
+};
+
+/*
+ * Rows [I0, I1) of a chunk. The chunk is kept alive as long as one of its blocks is.
+ */
+class RowBlock
+{
+public:
+	shared_ptr <const Chunk> Source;
+	size_t I0;
+	size_t I1;
+
+	/*
+	 * Blocks are numbered in the order of their rows
+	 */
+	size_t Seq;
+
+	/*
+	 * Base of row i, valid for I0 <= i < I1
+	 */
+	inline const uint8_t* rows () const
+	{
+		return Source->Data.data ();
+	}
+};
+
+
+/*
+ * Reads a FASTA file or stdin ("-"), possibly gzip compressed, in chunks that overlap by 49 bases, while the chunks read before are searched.
+ *
+ * A reader thread strips headers and line breaks and hands complete chunks to a bounded queue, where it blocks
+ * while STREAM_QUEUE_CHUNKS are waiting. Chunks have no record table, so the file must hold a single record: the
+ * program exits when a second one starts. Workers either take blocks of rows from the oldest chunk (gene1 streaming),
+ * or take whole chunks (gene2 tiles), not both.
+ */
+class ChunkStream
+{
+private:
+	unique_ptr <ByteSource> _source;
+	const char* const _path;
+	const size_t _chunkRows;
+	const size_t _blockRows;
+	const char _fill;
+
+	mutex _lock;
+	condition_variable _changed;
+	deque <shared_ptr <const Chunk>> _queue;
+	bool _eof;
+	size_t _len;
+	size_t _chunks;
+
+	shared_ptr <const Chunk> _current;
+	size_t _nextRow;
+	size_t _blocks;
+
+	thread _reader;
+
+	void read ();
+	void push (shared_ptr <Chunk>& chunk);
+
+public:
+	/*
+	 * Exits the program if the file cannot be opened.
+	 */
+	ChunkStream (const char* const path, const size_t chunkRows, const int nThreads, const char fill);
+	~ChunkStream ();
+
+	ChunkStream (const ChunkStream&) = delete;
+	ChunkStream& operator = (const ChunkStream&) = delete;
+
+	/*
+	 * Returns the next block of rows, waiting for the reader if necessary. Returns false once all rows are handed out.
+	 */
+	bool nextBlock (RowBlock& block);
+
+	/*
+	 * Returns the next complete chunk, waiting for the reader if necessary. Returns null at the end.
+	 */
+	shared_ptr <const Chunk> nextChunk ();
+
+	/*
+	 * Number of bases read so far, the length of gene1 once the stream has ended
+	 */
+	size_t length ();
+	size_t chunks ();
+};
+
+#endif // STREAM_H_INCLUDED
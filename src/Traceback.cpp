@@ -0,0 +1,189 @@
+/*
+ * Traceback of reported hits. The score matrix is the one of compare.h, but every cell also records which neighbour
+ * it came from. The window pairs of a batch are scored in the byte lanes of one register, so every cell costs one
+ * pass for all of them, and its direction bits are the movemask of the lane comparisons.
+ */
+
+#include <string.h>
+#include <algorithm>
+using namespace std;
+
+#include "Traceback.h"
+
+#if __AVX2__ && ALLOW_AVX
+#include <immintrin.h>
+#endif
+
+
+/*
+ * One bit per lane and cell: the cell took the diagonal, the cell above (I), or is 0 and ends the path.
+ * Cells that took none of them took the one to the left (D). Row and column 0 are the border of zeros.
+ */
+struct Directions
+{
+	uint32_t Diagonal [51][51];
+	uint32_t Up [51][51];
+	uint32_t Zero [51][51];
+};
+
+/*
+ * Bases of the windows, transposed so that each position holds one byte per lane
+ */
+struct Lanes
+{
+	alignas(32) uint8_t A [50][TRACEBACK_LANES];
+	alignas(32) uint8_t B [50][TRACEBACK_LANES];
+};
+
+#if __AVX2__ && ALLOW_AVX
+
+static void scoreLanes (const Lanes& l, Directions& d, uint8_t* best, uint8_t* bestY, uint8_t* bestX)
+{
+	const __m256i zero = _mm256_setzero_si256 ();
+	const __m256i one = _mm256_set1_epi8 (1);
+	const __m256i three = _mm256_set1_epi8 (3);
+	__m256i rows [2][51];
+	for (int x = 0; x < 51; x++) {
+		rows [0][x] = zero;
+	}
+	__m256i maxScore = zero;
+	__m256i maxY = zero;
+	__m256i maxX = zero;
+
+	for (int y = 1; y < 51; y++) {
+		const __m256i* const prev = rows [(y - 1) & 1];
+		__m256i* const cur = rows [y & 1];
+		const __m256i a = _mm256_load_si256 ((const __m256i*) l.A [y - 1]);
+		const __m256i rowY = _mm256_set1_epi8 (y);
+		cur [0] = zero;
+
+		for (int x = 1; x < 51; x++) {
+			const __m256i b = _mm256_load_si256 ((const __m256i*) l.B [x - 1]);
+			const __m256i omega = _mm256_and_si256 (_mm256_cmpeq_epi8 (a, b), three);
+			const __m256i diag = _mm256_add_epi8 (prev [x - 1], omega);
+			const __m256i up = prev [x];
+			const __m256i m = _mm256_max_epu8 (_mm256_max_epu8 (one, up), _mm256_max_epu8 (diag, cur [x - 1]));
+			const __m256i h = _mm256_sub_epi8 (m, one);
+			cur [x] = h;
+
+			d.Diagonal [y][x] = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (m, diag));
+			d.Up [y][x] = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (m, up));
+			d.Zero [y][x] = _mm256_movemask_epi8 (_mm256_cmpeq_epi8 (h, zero));
+
+			// scores stay below 128, so the signed comparison is fine
+			const __m256i improved = _mm256_cmpgt_epi8 (h, maxScore);
+			maxScore = _mm256_max_epu8 (maxScore, h);
+			maxY = _mm256_blendv_epi8 (maxY, rowY, improved);
+			maxX = _mm256_blendv_epi8 (maxX, _mm256_set1_epi8 (x), improved);
+		}
+	}
+
+	_mm256_storeu_si256 ((__m256i*) best, maxScore);
+	_mm256_storeu_si256 ((__m256i*) bestY, maxY);
+	_mm256_storeu_si256 ((__m256i*) bestX, maxX);
+}
+
+#else
+
+static void scoreLanes (const Lanes& l, Directions& d, uint8_t* best, uint8_t* bestY, uint8_t* bestX)
+{
+	for (int y = 1; y < 51; y++) {
+		for (int x = 1; x < 51; x++) {
+			d.Diagonal [y][x] = d.Up [y][x] = d.Zero [y][x] = 0;
+		}
+	}
+	for (int k = 0; k < TRACEBACK_LANES; k++) {
+		const uint32_t bit = 1u << k;
+		int mat [2][51] = {};
+		best [k] = bestY [k] = bestX [k] = 0;
+		for (int y = 1; y < 51; y++) {
+			int (&prev)[51] = mat [(y - 1) & 1];
+			int (&cur)[51] = mat [y & 1];
+			for (int x = 1; x < 51; x++) {
+				const int diag = prev [x - 1] + (l.A [y - 1][k] == l.B [x - 1][k] ? 3 : 0);
+				const int m = max (max (1, prev [x]), max (diag, cur [x - 1]));
+				cur [x] = m - 1;
+				d.Diagonal [y][x] |= m == diag ? bit : 0;
+				d.Up [y][x] |= m == prev [x] ? bit : 0;
+				d.Zero [y][x] |= m == 1 ? bit : 0;
+				if (cur [x] > best [k]) {
+					best [k] = cur [x];
+					bestY [k] = y;
+					bestX [k] = x;
+				}
+			}
+		}
+	}
+}
+
+#endif
+
+/*
+ * Follows the directions of lane k back from cell (y, x) to the first zero.
+ */
+static void trace (const Directions& d, const int k, int y, int x, Alignment& a)
+{
+	const uint32_t bit = 1u << k;
+	char ops [100];
+	int n = 0;
+	a.End1 = y;
+	a.End2 = x;
+	while (!(d.Zero [y][x] & bit)) {
+		if (d.Diagonal [y][x] & bit) {
+			ops [n++] = 'M';
+			y--;
+			x--;
+		} else if (d.Up [y][x] & bit) {
+			ops [n++] = 'I';
+			y--;
+		} else {
+			ops [n++] = 'D';
+			x--;
+		}
+	}
+	a.Start1 = y;
+	a.Start2 = x;
+
+	// the steps were taken from the end
+	char* p = a.Cigar;
+	for (int s = n - 1; s >= 0; ) {
+		int run = 1;
+		while (s - run >= 0 && ops [s - run] == ops [s]) {
+			run++;
+		}
+		p = writeDecimal (p, run);
+		*p++ = ops [s];
+		s -= run;
+	}
+	*p = 0;
+}
+
+void traceback (
+	const uint8_t* const* windows1,
+	const uint8_t* const* windows2,
+	const size_t n,
+	Alignment* out)
+{
+	Lanes l;
+	for (int y = 0; y < 50; y++) {
+		for (size_t k = 0; k < TRACEBACK_LANES; k++) {
+			// unused lanes never match
+			l.A [y][k] = k < n ? windows1 [k][y] : 0;
+			l.B [y][k] = k < n ? windows2 [k][y] : 1;
+		}
+	}
+
+	Directions d;
+	for (int k = 0; k < 51; k++) {
+		d.Zero [0][k] = d.Zero [k][0] = ~0u;
+	}
+	uint8_t best [TRACEBACK_LANES];
+	uint8_t bestY [TRACEBACK_LANES];
+	uint8_t bestX [TRACEBACK_LANES];
+	scoreLanes (l, d, best, bestY, bestX);
+
+	for (size_t k = 0; k < n; k++) {
+		out [k].Score = best [k];
+		trace (d, k, bestY [k], bestX [k], out [k]);
+	}
+}
@@ -0,0 +1,72 @@
+#ifndef TRACEBACK_H_INCLUDED
+#define TRACEBACK_H_INCLUDED
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "settings.h"
+#include "ResultFile.h"
+
+/*
+ * Window pairs aligned together by one call of traceback (), one per byte of an AVX2 register
+ */
+#define TRACEBACK_LANES 32
+
+/*
+ * A path through 50x50 cells has at most 99 steps, each run of the CIGAR takes at most 3 characters.
+ */
+#define TRACEBACK_CIGAR_BYTES (99 * 3 + 1)
+
+/*
+ * Local alignment of a window pair with the scoring of compare.h: +2 for a match, -1 for a mismatch or a gap.
+ * Start and End are offsets within the windows, End is exclusive. In the CIGAR, I consumes a base of the window of
+ * file 1 only, D one of file 2.
+ */
+struct Alignment
+{
+	int Score;
+	uint8_t Start1;
+	uint8_t End1;
+	uint8_t Start2;
+	uint8_t End2;
+	char Cigar [TRACEBACK_CIGAR_BYTES];
+
+	/*
+	 * Upper bound of the bytes written by write ()
+	 */
+	static inline size_t maxLength ()
+	{
+		return 4 * 3 + TRACEBACK_CIGAR_BYTES;
+	}
+
+	/*
+	 * Appends the CSV fields start1, end1, start2, end2 and cigar.
+	 */
+	inline char* write (char* p) const
+	{
+		const uint8_t offsets [4] = { Start1, End1, Start2, End2 };
+		for (uint8_t o : offsets) {
+			p = writeDecimal (p, o);
+			*p++ = ',';
+		}
+		for (const char* c = Cigar; *c; c++) {
+			*p++ = *c;
+		}
+		*p++ = ',';
+		return p;
+	}
+};
+
+/*
+ * Aligns the window pairs (windows1 [k], windows2 [k]) for k < n <= TRACEBACK_LANES. All pairs are scored together,
+ * recording which neighbour every cell came from at one bit per pair, and then traced back one by one from the
+ * first cell that reaches the best score. Ties prefer the diagonal, then I.
+ * Score is the exact one of compare_scalar, which all COMPARE kernels agree with.
+ */
+void traceback (
+	const uint8_t* const* windows1,
+	const uint8_t* const* windows2,
+	const size_t n,
+	Alignment* out);
+
+#endif // TRACEBACK_H_INCLUDED
@@ -0,0 +1,110 @@
+#include <string.h>
+#include <algorithm>
+#include <thread>
+
+#include "WindowDedup.h"
+
+
+static const size_t WINDOW = 50;
+static const uint64_t HASH_BASE = 0x100000001B3ull;
+
+struct HashedWindow
+{
+	uint64_t Hash;
+	size_t Start;
+
+	inline bool operator < (const HashedWindow& rhs) const
+	{
+		return Hash != rhs.Hash ? Hash < rhs.Hash : Start < rhs.Start;
+	}
+};
+
+/*
+ * Rolling polynomial hash of all windows starting in [k0, k1).
+ */
+static void hashRange (const uint8_t* const data, const size_t k0, const size_t k1, HashedWindow* const out)
+{
+	uint64_t top = 1;
+	for (size_t d = 1; d < WINDOW; d++) {
+		top *= HASH_BASE;
+	}
+
+	uint64_t h = 0;
+	for (size_t d = 0; d < WINDOW; d++) {
+		h = h * HASH_BASE + data [k0 + d];
+	}
+	for (size_t k = k0; k < k1; k++) {
+		out [k] = { h, k };
+		h = (h - data [k] * top) * HASH_BASE + data [k + WINDOW];
+	}
+}
+
+WindowGroups::WindowGroups (const uint8_t* const data, const size_t len, const int nThreads, const WindowMask* const mask)
+	:
+	_slot (len, NO_SLOT),
+	Slot (_slot.data ()),
+	First (),
+	Duplicates (0)
+{
+	vector <HashedWindow> hashed (len);
+
+	vector <thread> threads;
+	for (int t = 0; t < nThreads; t++) {
+		size_t k0 = len * t / nThreads;
+		size_t k1 = len * (t + 1) / nThreads;
+		if (k0 < k1) {
+			threads.push_back (thread (hashRange, data, k0, k1, hashed.data ()));
+		}
+	}
+	for (auto& t : threads) {
+		t.join ();
+	}
+
+	if (mask) {
+		hashed.erase (
+			remove_if (hashed.begin (), hashed.end (), [mask] (const HashedWindow& w) {
+				return mask->isMasked (w.Start);
+			}),
+			hashed.end ());
+	}
+	sort (hashed.begin (), hashed.end ());
+	const size_t n = hashed.size ();
+
+	/*
+	 * Within a run of equal hashes, entries are ordered by position, so the first match found is the first occurrence.
+	 * Hash collisions only cost a few extra comparisons.
+	 */
+	vector <size_t> reps;
+	for (size_t a = 0; a < n;) {
+		size_t b = a + 1;
+		while (b < n && hashed [b].Hash == hashed [a].Hash) {
+			b++;
+		}
+		if (b - a == 1) {
+			a = b;
+			continue;
+		}
+
+		reps.clear ();
+		for (size_t e = a; e < b; e++) {
+			const size_t k = hashed [e].Start;
+			bool found = false;
+			for (size_t r : reps) {
+				if (memcmp (&data [r], &data [k], WINDOW) == 0) {
+					if (_slot [r] == NO_SLOT) {
+						_slot [r] = First.size ();
+						First.push_back (r);
+					}
+					_slot [k] = _slot [r];
+					Duplicates++;
+					found = true;
+					break;
+				}
+			}
+			if (!found) {
+				reps.push_back (k);
+			}
+		}
+		a = b;
+	}
+}
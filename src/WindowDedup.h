@@ -0,0 +1,122 @@
+#ifndef WINDOWDEDUP_H_INCLUDED
+#define WINDOWDEDUP_H_INCLUDED
+
+#include <stdint.h>
+#include <vector>
+using namespace std;
+
+#include "Results.h"
+#include "Mask.h"
+
+
+/*
+ * Groups the byte-identical 50 byte windows of a sequence.
+ *
+ * Every window start is rolling-hashed, the hashes are sorted, and windows with equal hash are compared byte by
+ * byte. Windows that occur more than once share a slot; windows that occur only once have NO_SLOT.
+ * Masked windows are never searched, so they are left out and have NO_SLOT as well.
+ */
+class WindowGroups
+{
+private:
+	vector <uint32_t> _slot;
+
+public:
+	static const uint32_t NO_SLOT = UINT32_MAX;
+
+	/*
+	 * Slot of every window start, or NO_SLOT
+	 */
+	const uint32_t* Slot;
+
+	/*
+	 * First (lowest) window start of each slot
+	 */
+	vector <size_t> First;
+
+	/*
+	 * Number of windows that are identical to an earlier window
+	 */
+	size_t Duplicates;
+
+	/*
+	 * The sequence must be readable for 50 bytes past the last window start.
+	 */
+	WindowGroups (const uint8_t* const data, const size_t len, const int nThreads, const WindowMask* const mask);
+
+	/*
+	 * Groups stored elsewhere, slot must stay valid while the groups are in use.
+	 */
+	inline WindowGroups (const uint32_t* const slot, const vector <size_t>& first, const size_t duplicates)
+		:
+		_slot (),
+		Slot (slot),
+		First (first),
+		Duplicates (duplicates)
+	{
+	}
+
+	WindowGroups (const WindowGroups&) = delete;
+	WindowGroups& operator = (const WindowGroups&) = delete;
+
+	inline bool isDuplicate (const size_t k) const
+	{
+		uint32_t s = Slot [k];
+		return s != NO_SLOT && First [s] != k;
+	}
+};
+
+/*
+ * Holds the results of gene1 rows that have duplicates, so the duplicates can be reported without being searched.
+ */
+class DuplicateRows
+{
+private:
+	const WindowGroups& _groups;
+	vector <Result> _results;
+
+public:
+	inline DuplicateRows (const WindowGroups& groups)
+		:
+		_groups (groups),
+		_results ()
+	{
+		_results.reserve (groups.First.size ());
+		for (size_t i : groups.First) {
+			_results.push_back (Result (i));
+		}
+	}
+
+	inline bool isDuplicate (const size_t i) const
+	{
+		return _groups.isDuplicate (i);
+	}
+
+	/*
+	 * Called for every row that was searched. Each slot is written by exactly one thread.
+	 */
+	inline void store (const size_t i, const Result& res)
+	{
+		uint32_t s = _groups.Slot [i];
+		if (s != WindowGroups::NO_SLOT) {
+			_results [s] = res;
+		}
+	}
+
+	/*
+	 * Reports the stored result for every duplicate row in [i0, i1).
+	 */
+	template <class F>
+	inline void replay (const size_t i0, const size_t i1, F add) const
+	{
+		for (size_t i = i0; i < i1; i++) {
+			if (isDuplicate (i)) {
+				Result r = _results [_groups.Slot [i]].forRow (i);
+				add (r);
+			}
+		}
+	}
+};
+
+
+#endif // WINDOWDEDUP_H_INCLUDED
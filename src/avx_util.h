@@ -1,10 +1,19 @@
 #ifndef AVX_UTIL_H_INCLUDED
 #define AVX_UTIL_H_INCLUDED
 
+#include <immintrin.h>
 #include <iostream>
 using namespace std;
 
 
+static const __m256i plus_1 = _mm256_set1_epi8 (1);
+
+static const __m256i V_15_0_16 = _mm256_setr_epi8 (
+	15, 14, 13, 12, 11, 10, 9, 8,
+	7, 6, 5, 4, 3, 2, 1, 0,
+	1, 2, 3, 4, 5, 6, 7, 8,
+	9, 10, 11, 12, 13, 14, 15, 16);
+
 inline void print (const __m256i m)
 {
 	alignas(32) uint8_t t[32];
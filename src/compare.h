@@ -2,6 +2,7 @@
 #define COMPARE_H_INCLUDED
 
 #include <stdint.h>
+#include <stddef.h>
 
 #include "settings.h"
 
@@ -20,14 +21,74 @@ int compare_avx (
 	const uint8_t* __restrict__ p2
 );
 
+/*
+ * Compares against the 2 bit packed gene2 at base j, see PackedSequence.
+ * codes1 holds the 50 bases of the gene1 window, each repeated in all four fields of its byte (code * 0x55), and
+ * case1 0xFF for each of them that is lower case. case2 is the case bitmap of gene2, or null if it has none.
+ * Neither window may contain exceptions.
+ */
+int compare_avx_packed (
+	const uint8_t* __restrict__ codes1,
+	const uint8_t* __restrict__ case1,
+	const uint8_t* __restrict__ bits2,
+	const uint8_t* __restrict__ case2,
+	const size_t j
+);
+
+class ScoreMatrix;
+
+/*
+ * Protein mode: scores with a substitution matrix and its gap penalty, see ScoreMatrix.
+ * The AVX2 variant passes the windows whose scores do not fit into a byte on to the scalar one.
+ */
+int compare_scalar_profile (
+	const uint8_t* __restrict__ p1,
+	const uint8_t* __restrict__ p2,
+	const ScoreMatrix& matrix
+);
+
+int compare_avx_profile (
+	const uint8_t* __restrict__ p1,
+	const uint8_t* __restrict__ p2,
+	const ScoreMatrix& matrix
+);
+
+/*
+ * Lane mode: scores the COMPARE_LANES consecutive windows p1, p1 + 1, ... against p2 at once and writes the score of
+ * window p1 + k to scores [k]. All of them are read, whether their scores are used or not.
+ * Scores are exact like those of compare_scalar, compare_sse and compare_avx.
+ */
+#define COMPARE_LANES 32
+
+void compare_scalar_lanes (
+	const uint8_t* __restrict__ p1,
+	const uint8_t* __restrict__ p2,
+	uint8_t* __restrict__ scores
+);
+
+void compare_avx_lanes (
+	const uint8_t* __restrict__ p1,
+	const uint8_t* __restrict__ p2,
+	uint8_t* __restrict__ scores
+);
+
 
 #if __AVX2__ && ALLOW_AVX
 #define COMPARE compare_avx
+#define COMPARE_PACKED compare_avx_packed
 #elif __SSSE3__ && ALLOW_SSE
 #define COMPARE compare_sse
 #else
 #define COMPARE compare_scalar
 #endif
 
+#if __AVX2__ && ALLOW_AVX
+#define COMPARE_PROFILE compare_avx_profile
+#define COMPARE_ROWS compare_avx_lanes
+#else
+#define COMPARE_PROFILE compare_scalar_profile
+#define COMPARE_ROWS compare_scalar_lanes
+#endif
+
 
 #endif // COMPARE_H_INCLUDED
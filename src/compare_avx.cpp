@@ -8,10 +8,14 @@
  */
 
 #include <stdint.h>
+#include <string.h>
 #include <immintrin.h>
 #include <iostream>
 using namespace std;
 
+#include "compare.h"
+#include "ScoreMatrix.h"
+
 //#include "avx_util.h"
 
 
@@ -61,13 +65,53 @@ static const __m256i submask4 = _mm256_setr_epi8 (
 	1, 2, 3, 4, 5, 6, 7, 8,
 	9, 10, 11, 12, 13, 14, 15, 16);
 
-int compare_avx (const uint8_t* __restrict__ p1, const uint8_t* __restrict__ p2)
+/*
+ * The columns 32 .. 49 of the second half of a window, the rest lies past it.
+ */
+static const __m256i window_tail = _mm256_cmpgt_epi8 (_mm256_set1_epi8 (50 - 32 + 1), ramp_1_32);
+
+/*
+ * The maximum of all 32 bytes. Byte shifts stay within 128 bit lanes, so the halves are folded onto each other first.
+ */
+static inline int reduce_max (const __m256i v)
+{
+	__m128i m = _mm_max_epu8 (_mm256_castsi256_si128 (v), _mm256_extracti128_si256 (v, 1));
+	m = _mm_max_epu8 (m, _mm_srli_si128 (m, 8));
+	m = _mm_max_epu8 (m, _mm_srli_si128 (m, 4));
+	m = _mm_max_epu8 (m, _mm_srli_si128 (m, 2));
+	m = _mm_max_epu8 (m, _mm_srli_si128 (m, 1));
+	return _mm_extract_epi8 (m, 0);
+}
+
+/*
+ * Subtrahends of the gap penalty: the penalty itself, and the multiples the rows are spread to the right with.
+ */
+struct GapMasks
+{
+	__m256i Gap;
+	__m256i Sub1;
+	__m256i Sub2;
+	__m256i Sub3;
+	__m256i Sub4;
+	__m256i Ramp;
+};
+
+static const GapMasks unit_gap = { plus_1, submask1, submask2, submask3, submask4, ramp_1_32 };
+
+/*
+ * The kernel shared by the byte, the packed and the protein variant.
+ * diagonal (y, x, prev0) returns the diagonal neighbours prev0 of the lanes of columns x * 32 .. x * 32 + 31 in row y
+ * (1 based) plus the cell's score plus the gap penalty, which is then subtracted from the cell like from its
+ * neighbours above and to the left.
+ * clip drops the columns past the window from the maximum, they need not be dropped if they can never score higher
+ * than the window. Returns the maximum of every lane over all rows.
+ */
+template <class Diagonal>
+static inline __attribute__((always_inline)) __m256i compare_avx_core (Diagonal diagonal, const GapMasks& g, const bool clip)
 {
 	alignas(64) uint8_t mat0[32 * 3] = {0};
 	alignas(64) uint8_t mat1[32 * 3] = {0};
 
-	p1--;
-
 	__m256i global_max = _mm256_setzero_si256 ();
 
 	for (int y = 1; y < 51; y++) {
@@ -76,67 +120,259 @@ int compare_avx (const uint8_t* __restrict__ p1, const uint8_t* __restrict__ p2)
 		alignas(32) uint8_t (& prev)[32 * 3] = (y & 1) == 0 ? mat0 : mat1;
 		alignas(32) uint8_t (& cur )[32 * 3] = (y & 1) != 0 ? mat0 : mat1;
 
-		uint8_t ai = p1[y];
-		__m256i aiv = _mm256_set1_epi8 (ai);
-
 		for (int x = 0; x < 2; x++) {
-			__m256i bjv     = _mm256_loadu_si256 ((__m256i*) &(p2[x * 32]));
-			__m256i omega   = _mm256_cmpeq_epi8  (aiv, bjv);
-				omega   = _mm256_and_si256   (omega, plus_3);
 			__m256i prev0   = _mm256_loadu_si256 ((__m256i*) &(prev[(x + 1) * 32 - 1]));
-			__m256i i3      = _mm256_adds_epu8   (prev0, omega);
+			__m256i i3      = diagonal (y, x, prev0);
 
 			__m256i prev1   = _mm256_load_si256  ((__m256i*) &(prev[(x + 1) * 32 - 0]));
 			__m256i i1      = prev1;
 
 			__m256i prelim  = _mm256_max_epu8    (i1, i3);
-				prelim  = _mm256_subs_epu8   (prelim, plus_1);
+				prelim  = _mm256_subs_epu8   (prelim, g.Gap);
 
 			__m256i t;
 
 			t      = _mm256_slli_si256   (prelim, 1);
-			t      = _mm256_subs_epu8    (t, plus_1);
+			t      = _mm256_subs_epu8    (t, g.Gap);
 			prelim = _mm256_max_epu8     (prelim, t);
 
 			t      = _mm256_shuffle_epi8 (prelim, shufmask1);
-			t      = _mm256_subs_epu8    (t, submask1);
+			t      = _mm256_subs_epu8    (t, g.Sub1);
 			prelim = _mm256_max_epu8     (prelim, t);
 
 			t      = _mm256_shuffle_epi8 (prelim, shufmask2);
-			t      = _mm256_subs_epu8    (t, submask2);
+			t      = _mm256_subs_epu8    (t, g.Sub2);
 			prelim = _mm256_max_epu8     (prelim, t);
 
 			t      = _mm256_shuffle_epi8 (prelim, shufmask3);
-			t      = _mm256_subs_epu8    (t, submask3);
+			t      = _mm256_subs_epu8    (t, g.Sub3);
 			prelim = _mm256_max_epu8     (prelim, t);
 
 			t      = _mm256_permute4x64_epi64 (prelim, 0b01000100);
 			t      = _mm256_shuffle_epi8 (t, shufmask4);
-			t      = _mm256_subs_epu8    (t, submask4);
+			t      = _mm256_subs_epu8    (t, g.Sub4);
 			prelim = _mm256_max_epu8     (prelim, t);
 
 			prev_res = _mm256_permute4x64_epi64 (prev_res, 0b11101110);
 			prev_res = _mm256_shuffle_epi8 (prev_res, plus_15);
-			prev_res = _mm256_subs_epu8    (prev_res, ramp_1_32);
+			prev_res = _mm256_subs_epu8    (prev_res, g.Ramp);
 			prelim   = _mm256_max_epu8     (prelim, prev_res);
 
 			prev_res = prelim;
 
 			_mm256_store_si256 ((__m256i*) &(cur[(x + 1) * 32]), prelim);
 
-			if (x == 1) {
+			if (x == 1 && clip) {
 				// prelim contains overhead that should be excluded.
-				prelim = _mm256_slli_si256 (prelim, 32 - 18);
+				prelim = _mm256_and_si256 (prelim, window_tail);
 			}
 			global_max = _mm256_max_epu8 (global_max, prelim);
 		}
 	}
 
-	global_max = _mm256_max_epu8 (global_max, _mm256_slli_si256 (global_max, 1));
-	global_max = _mm256_max_epu8 (global_max, _mm256_slli_si256 (global_max, 2));
-	global_max = _mm256_max_epu8 (global_max, _mm256_slli_si256 (global_max, 4));
-	global_max = _mm256_max_epu8 (global_max, _mm256_slli_si256 (global_max, 8));
-	global_max = _mm256_max_epu8 (global_max, _mm256_slli_si256 (global_max, 16));
-	int gm = _mm256_extract_epi8 (global_max, 31);
-	return gm;
+	return global_max;
+}
+
+/*
+ * DNA: match (y, x) returns 0xFF in the lanes that match, which score 3 before the gap is subtracted.
+ */
+template <class Match>
+static inline __attribute__((always_inline)) int compare_avx_match (Match match)
+{
+	__m256i global_max = compare_avx_core ([match] (int y, int x, __m256i prev0) {
+		return _mm256_adds_epu8 (prev0, _mm256_and_si256 (match (y, x), plus_3));
+	}, unit_gap, true);
+
+	return reduce_max (global_max);
+}
+
+int compare_avx (const uint8_t* __restrict__ p1, const uint8_t* __restrict__ p2)
+{
+	p1--;
+	return compare_avx_match ([p1, p2] (int y, int x) {
+		__m256i aiv = _mm256_set1_epi8 (p1[y]);
+		__m256i bjv = _mm256_loadu_si256 ((__m256i*) &(p2[x * 32]));
+		return _mm256_cmpeq_epi8 (aiv, bjv);
+	});
+}
+
+
+/*
+ * Spreads 16 bytes of 2 bit codes over 64 lanes: lane k receives byte k / 4, whose bits 2 * (k % 4) hold base k.
+ */
+static const __m256i expand_lo = _mm256_setr_epi8 (
+	0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3,
+	4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7);
+static const __m256i expand_hi = _mm256_setr_epi8 (
+	8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11,
+	12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15);
+static const __m256i field_mask = _mm256_set1_epi32 (0xC0300C03);
+
+/*
+ * Spreads 32 bits over 32 lanes: lane k receives byte k / 8 and keeps bit k % 8 of it.
+ */
+static const __m256i spread_bits = _mm256_setr_epi8 (
+	0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+	2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3);
+static const __m256i select_bit = _mm256_set1_epi64x (0x8040201008040201);
+
+static inline __m256i expand_bits (const uint32_t bits)
+{
+	__m256i v = _mm256_shuffle_epi8 (_mm256_set1_epi32 (bits), spread_bits);
+	return _mm256_cmpeq_epi8 (_mm256_and_si256 (v, select_bit), select_bit);
+}
+
+int compare_avx_packed (
+	const uint8_t* __restrict__ codes1,
+	const uint8_t* __restrict__ case1,
+	const uint8_t* __restrict__ bits2,
+	const uint8_t* __restrict__ case2,
+	const size_t j)
+{
+	/*
+	 * Bases j .. j + 63 of gene2 as 128 bits.
+	 */
+	const uint8_t* b = bits2 + (j >> 2);
+	const int sh = (j & 3) * 2;
+	uint64_t w [3];
+	memcpy (w, b, sizeof (w));
+	uint64_t lo = sh ? (w [0] >> sh) | (w [1] << (64 - sh)) : w [0];
+	uint64_t hi = sh ? (w [1] >> sh) | (w [2] << (64 - sh)) : w [1];
+
+	const __m256i packed = _mm256_broadcastsi128_si256 (_mm_set_epi64x (hi, lo));
+	const __m256i bj [2] = {
+		_mm256_shuffle_epi8 (packed, expand_lo),
+		_mm256_shuffle_epi8 (packed, expand_hi)
+	};
+	const __m256i zero = _mm256_setzero_si256 ();
+
+	/*
+	 * The case bits of bases j .. j + 63 of gene2 as 0xFF in the lanes of the lower case ones.
+	 */
+	uint64_t c = 0;
+	if (case2) {
+		const int shc = j & 7;
+		memcpy (w, case2 + (j >> 3), 2 * sizeof (uint64_t));
+		c = shc ? (w [0] >> shc) | (w [1] << (64 - shc)) : w [0];
+	}
+	const __m256i lower2 [2] = {
+		expand_bits ((uint32_t) c),
+		expand_bits ((uint32_t) (c >> 32))
+	};
+
+	/*
+	 * A base of gene1 repeated in all four fields of a byte, xor leaves zero in the fields that hold the same base.
+	 * It only matches if the case is the same, too.
+	 */
+	codes1--;
+	case1--;
+	return compare_avx_match ([codes1, case1, &bj, &lower2, zero] (int y, int x) {
+		__m256i aiv = _mm256_set1_epi8 (codes1[y]);
+		__m256i diff = _mm256_and_si256 (_mm256_xor_si256 (aiv, bj [x]), field_mask);
+		__m256i other_case = _mm256_xor_si256 (_mm256_set1_epi8 (case1[y]), lower2 [x]);
+		return _mm256_andnot_si256 (other_case, _mm256_cmpeq_epi8 (diff, zero));
+	});
+}
+
+
+/*
+ * Protein mode. The row of weights of each residue of gene1 is looked up for the 64 bytes of the gene2 window with
+ * one shuffle per quarter of the row. Weights are biased to be unsigned, so the bias is subtracted after adding them
+ * with saturation, and the columns past the window get weight 0, which keeps them below the window's maximum.
+ * A sum that saturates means the score does not fit into a byte, then the scalar kernel gives the exact one.
+ */
+int compare_avx_profile (const uint8_t* __restrict__ p1, const uint8_t* __restrict__ p2, const ScoreMatrix& matrix)
+{
+	const __m256i mask_63 = _mm256_set1_epi8 (63);
+	const __m256i bias = _mm256_set1_epi8 (matrix.bias ());
+	const __m256i keep [2] = {
+		_mm256_set1_epi8 (-1),
+		window_tail
+	};
+
+	/*
+	 * Slots of the gene2 window, see ScoreMatrix::slot, and the blend masks that pick their quarter of a row.
+	 */
+	__m256i slots [2];
+	__m256i upper16 [2];
+	__m256i upper32 [2];
+	for (int x = 0; x < 2; x++) {
+		__m256i b = _mm256_loadu_si256 ((__m256i*) &(p2[x * 32]));
+		__m256i lower = _mm256_and_si256 (
+			_mm256_cmpgt_epi8 (b, _mm256_set1_epi8 ('a' - 1)),
+			_mm256_cmpgt_epi8 (_mm256_set1_epi8 ('z' + 1), b));
+		b = _mm256_sub_epi8 (b, _mm256_and_si256 (lower, _mm256_set1_epi8 (32)));
+		slots [x] = _mm256_and_si256 (b, mask_63);
+		upper16 [x] = _mm256_slli_epi16 (slots [x], 3);
+		upper32 [x] = _mm256_slli_epi16 (slots [x], 2);
+	}
+
+	GapMasks g = unit_gap;
+	for (int k = 1; k < matrix.Gap; k++) {
+		g.Gap  = _mm256_adds_epu8 (g.Gap, unit_gap.Gap);
+		g.Sub1 = _mm256_adds_epu8 (g.Sub1, unit_gap.Sub1);
+		g.Sub2 = _mm256_adds_epu8 (g.Sub2, unit_gap.Sub2);
+		g.Sub3 = _mm256_adds_epu8 (g.Sub3, unit_gap.Sub3);
+		g.Sub4 = _mm256_adds_epu8 (g.Sub4, unit_gap.Sub4);
+		g.Ramp = _mm256_adds_epu8 (g.Ramp, unit_gap.Ramp);
+	}
+
+	__m256i saturated = _mm256_setzero_si256 ();
+	p1--;
+	const __m256i global_max = compare_avx_core ([&] (int y, int x, __m256i prev0) {
+		const uint8_t* row = matrix.Weights [ScoreMatrix::slot (p1[y])];
+		__m256i q0 = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((__m128i*) &(row[0])));
+		__m256i q1 = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((__m128i*) &(row[16])));
+		__m256i q2 = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((__m128i*) &(row[32])));
+		__m256i q3 = _mm256_broadcastsi128_si256 (_mm_loadu_si128 ((__m128i*) &(row[48])));
+		__m256i lo = _mm256_blendv_epi8 (_mm256_shuffle_epi8 (q0, slots [x]), _mm256_shuffle_epi8 (q1, slots [x]), upper16 [x]);
+		__m256i hi = _mm256_blendv_epi8 (_mm256_shuffle_epi8 (q2, slots [x]), _mm256_shuffle_epi8 (q3, slots [x]), upper16 [x]);
+		__m256i w = _mm256_and_si256 (_mm256_blendv_epi8 (lo, hi, upper32 [x]), keep [x]);
+		__m256i sum = _mm256_adds_epu8 (prev0, w);
+		saturated = _mm256_max_epu8 (saturated, sum);
+		return _mm256_subs_epu8 (sum, bias);
+	}, g, false);
+
+	if (_mm256_movemask_epi8 (_mm256_cmpeq_epi8 (saturated, _mm256_set1_epi8 (-1)))) {
+		return compare_scalar_profile (p1 + 1, p2, matrix);
+	}
+	return reduce_max (global_max);
+}
+
+/*
+ * Lane mode: the rows run across the lanes instead of the columns. Lane k holds the cell of window p1 + k, so the
+ * bases of row y of all 32 windows are the 32 bytes from p1 + y, and the gene2 base of a column is broadcast.
+ * Every cell then only depends on neighbours in the same lane, which leaves no shifts and no reduction, and scores
+ * exactly like compare_scalar.
+ */
+void compare_avx_lanes (const uint8_t* __restrict__ p1, const uint8_t* __restrict__ p2, uint8_t* __restrict__ scores)
+{
+	__m256i b [50];
+	for (int x = 0; x < 50; x++) {
+		b [x] = _mm256_set1_epi8 (p2 [x]);
+	}
+	__m256i h [51];
+	for (int x = 0; x < 51; x++) {
+		h [x] = _mm256_setzero_si256 ();
+	}
+
+	__m256i global_max = _mm256_setzero_si256 ();
+	for (int y = 0; y < 50; y++) {
+		const __m256i a = _mm256_loadu_si256 ((__m256i*) &(p1[y]));
+		__m256i diag = _mm256_setzero_si256 ();
+		__m256i left = _mm256_setzero_si256 ();
+
+		for (int x = 0; x < 50; x++) {
+			const __m256i up = h [x + 1];
+			const __m256i i2 = _mm256_add_epi8 (diag, _mm256_and_si256 (_mm256_cmpeq_epi8 (a, b [x]), plus_3));
+			__m256i m = _mm256_max_epu8 (_mm256_max_epu8 (plus_1, up), _mm256_max_epu8 (i2, left));
+			m = _mm256_sub_epi8 (m, plus_1);
+			h [x + 1] = m;
+			diag = up;
+			left = m;
+			global_max = _mm256_max_epu8 (global_max, m);
+		}
+	}
+
+	_mm256_storeu_si256 ((__m256i*) scores, global_max);
 }
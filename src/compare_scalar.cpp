@@ -3,6 +3,7 @@
  */
 
 #include "compare.h"
+#include "ScoreMatrix.h"
 
 #include <iostream>
 using namespace std;
@@ -54,3 +55,44 @@ int compare_scalar (
 
 	return global_max;
 }
+
+int compare_scalar_profile (
+	const uint8_t* __restrict__ p1,
+	const uint8_t* __restrict__ p2,
+	const ScoreMatrix& matrix
+	)
+{
+	int mat[2][51] = {};
+	const int gap = matrix.Gap;
+	const int offset = matrix.Gap + matrix.bias ();
+
+	int global_max = 0;
+
+	for (int y = 1; y < 51; y++) {
+		int (&prev)[51] = mat[(y - 1) & 1];
+		int (&cur )[51] = mat[y & 1];
+		const uint8_t* weights = matrix.Weights[ScoreMatrix::slot (p1[y - 1])];
+
+		for (int x = 1; x < 51; x++) {
+			int max = prev[x-1] + weights[ScoreMatrix::slot (p2[x - 1])] - offset;
+			max = max > prev[x] - gap ? max : prev[x] - gap;
+			max = max > cur[x-1] - gap ? max : cur[x-1] - gap;
+			max = max > 0 ? max : 0;
+			cur[x] = max;
+			global_max = max > global_max ? max : global_max;
+		}
+	}
+
+	return global_max;
+}
+
+void compare_scalar_lanes (
+	const uint8_t* __restrict__ p1,
+	const uint8_t* __restrict__ p2,
+	uint8_t* __restrict__ scores
+	)
+{
+	for (int k = 0; k < COMPARE_LANES; k++) {
+		scores[k] = compare_scalar (p1 + k, p2);
+	}
+}
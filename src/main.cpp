@@ -6,6 +6,16 @@
 #include "compare.h"
 
 #include "SearchMgr.h"
+#include "Skipper.h"
+#include "WindowDedup.h"
+#include "Band.h"
+#include "Mask.h"
+#include "Sequence.h"
+#include "PackedSequence.h"
+#include "Stream.h"
+#include "Index.h"
+#include "ResultFile.h"
+#include "ScoreMatrix.h"
 
 
 using namespace std;
@@ -24,37 +34,89 @@ double elapsed (bool includeInitialization)
 	return dur.count ();
 }
 
-string readFile (const char* const path, size_t& len, char fill)
+/*
+ * Loads a FASTA file and reports it the way the line-by-line reader used to.
+ */
+unique_ptr <Sequence> readFile (const char* const path, const char fill, const int nThreads)
 {
-	ifstream ifs (path, ifstream::binary | ifstream::ate);
-	if (!ifs) {
-		cout << "could not open path " << path << endl;
-		exit (7);
+	unique_ptr <Sequence> seq (new Sequence (path, fill, nThreads));
+	for (auto& h : seq->Headers) {
+		cout << '>' << h << endl;
 	}
+	cout << "Loaded " << seq->Len << " effective bytes (file size: " << seq->FileSize << "b)";
+	if (seq->records () > 1) {
+		cout << " in " << seq->records () << " records";
+	}
+	cout << endl;
+	return seq;
+}
 
-	string s;
-	auto len0 = ifs.tellg ();
-	s.reserve (static_cast<unsigned long long> (len0) + 51ull + 32ull);
-	ifs.seekg (0);
+/*
+ * Opens an index of file 2 and reports it like a loaded file.
+ */
+unique_ptr <Sequence> openIndex (const char* const path, const ReferenceIndex& index)
+{
+	unique_ptr <Sequence> seq = index.sequence ();
+	for (auto& h : seq->Headers) {
+		cout << '>' << h << endl;
+	}
+	cout << "Opened index " << path << " of " << seq->Len << " effective bytes";
+	if (seq->records () > 1) {
+		cout << " in " << seq->records () << " records";
+	}
+	cout << endl;
+	return seq;
+}
 
-	for (string line; getline (ifs, line);) {
-		if (line[0] == '>') {
-			cout << line << endl;
-			continue;
-		}
-		s += line;
+/*
+ * Returns null if nothing is masked.
+ */
+unique_ptr <WindowMask> buildMask (
+	const Sequence& gene,
+	const size_t minNRun,
+	const char* const excludePath,
+	const char* const includePath,
+	const bool reverse = false)
+{
+	unique_ptr <WindowMask> mask (new WindowMask (gene.Len));
+	if (minNRun > 0) {
+		mask->addNRuns (gene.Data, minNRun);
+	}
+	mask->addRecordGaps (gene);
+	if (excludePath) {
+		mask->addRegions (excludePath, false, gene, reverse);
 	}
-	len = s.size ();
+	if (includePath) {
+		mask->addRegions (includePath, true, gene, reverse);
+	}
+	mask->finish ();
 
-	/*
-	 * Add bonus space.
-	 * 50 for regular processing past the end of line.
-	 * 32 for worst case overhead from AVX processing.
-	 */
-	s += string (50 + 32, fill);
+	if (mask->empty ()) {
+		mask.reset ();
+	}
+	return mask;
+}
 
-	cout << "Loaded " << len << " effective bytes (file size: " << len0 << "b)" << endl;
-	return s;
+/*
+ * Loads file 2 with everything the options derive from it and stores it as an index.
+ */
+int buildIndex (const Options& opts)
+{
+	cout << "Reading " << opts.InPath2 << "..." << endl;
+	unique_ptr <Sequence> gene = readFile (opts.InPath2, Sequence::Fill2, opts.ThreadCount);
+	unique_ptr <WindowMask> mask = buildMask (*gene, opts.MaskNRun, opts.Exclude2, opts.Include2);
+	unique_ptr <PackedSequence> packed;
+	if (opts.Packed) {
+		packed.reset (new PackedSequence (gene->Data, gene->Len, gene->Len + 50 + 32, opts.ThreadCount));
+	}
+	unique_ptr <WindowGroups> groups;
+	if (opts.Dedup) {
+		groups.reset (new WindowGroups (gene->Data, gene->Len, opts.ThreadCount, mask.get ()));
+	}
+	ReferenceIndex::write (opts.OutPath, *gene, mask.get (), packed.get (), groups.get (), opts.MaskNRun);
+	printf ("Index written to %s in %.3f s (masked windows: %zu%s%s)\n", opts.OutPath, elapsed (true),
+	        mask ? mask->count () : 0, packed ? ", packed" : "", groups ? ", duplicate windows" : "");
+	return 1;
 }
 
 void printCPU ()
@@ -136,48 +198,29 @@ int main (int argc, char* argv[])
 {
 	timeInit = chrono::system_clock::now ();
 
-	const char* inPath1;
-	const char* inPath2;
-	const char* outPath;
-	int nThreads;
-	int threshold;
-
-	if (argc == 1) {
-		cout << "Usage:" << endl;
-		cout << "swa in_path1 in_path2 nThreads threshold out_path" << endl;
-		cout << "Starting the program without parameters uses default settings for 4 cores" << endl;
-		cout << endl;
-
+	Options opts;
+	if (!opts.parse (argc, argv)) {
+		Options::printUsage ();
 		cout << "Using default parameters." << endl;
-		inPath1 = "data/sox3.fas";
 		#if 0
-		inPath1 = "data/246.fas";
+		opts.InPath1 = "data/246.fas";
 		#endif
-		inPath2 = "data/sry.fas";
-		nThreads = 4;
-		threshold = 70;
-		outPath = "out.csv";
-	} else {
-		inPath1 = argv[1];
-		inPath2 = argv[2];
-		nThreads = atoi (argv[3]);
-		threshold = atoi (argv[4]);
-		outPath = argv[5];
 	}
 	cout << endl << endl;
 
+	if (opts.BuildIndex) {
+		return buildIndex (opts);
+	}
+	if (opts.ConvertResults) {
+		convertResults (opts.InPath1, opts.OutPath);
+		return 1;
+	}
+
 	if (1) {
 		cout << "Compilation flags: "
 		     << "ENABLE_SKIPPING = " << ENABLE_SKIPPING
 		     << ", SKIPPING_STATS = " << SKIPPING_STATS
 		     << ", VERTICAL_SKIP_LIMIT = " << VERTICAL_SKIP_LIMIT
-		     << ", LOOKUP_STRATEGY = "
-		     << ( LOOKUP_STRATEGY == STRATEGY_MEMSET  ? "memset"
-			: LOOKUP_STRATEGY == STRATEGY_DLLIST  ? "dllist"
-			: LOOKUP_STRATEGY == STRATEGY_SLLIST  ? "sllist"
-			: LOOKUP_STRATEGY == STRATEGY_AVXSET1 ? "avxset1"
-			: LOOKUP_STRATEGY == STRATEGY_AVXSET2 ? "avxset2"
-			: "none")
 		     << endl;
 		printCPU ();
 		auto mode =
@@ -185,30 +228,165 @@ int main (int argc, char* argv[])
 			COMPARE == compare_sse ? "128" :
 			"64";
 		cout << "Selected operation width: " << mode << " bit" << endl;
-		cout << "Thread count: " << nThreads << endl;
+		cout << "Skipping strategy: " << strategyName (opts.Strategy) << endl;
+		cout << "Vertical skip limit: ";
+		if (opts.SkipLimit == SKIP_LIMIT_ADAPTIVE) {
+			cout << "auto";
+		} else {
+			cout << opts.SkipLimit;
+		}
+		cout << endl;
+		cout << "Thread count: " << opts.ThreadCount << endl;
 		cout << endl << endl;
 	}
 
+	if (ReferenceIndex::isIndex (opts.InPath1)) {
+		cout << "an index can only be used as file 2" << endl;
+		exit (2);
+	}
 	cout << "Reading genes..." << endl;
-	size_t len1;
-	size_t len2;
-	string gene1 = readFile (inPath1, len1, '1');
-	string gene2 = readFile (inPath2, len2, '2');
+	unique_ptr <Sequence> gene1 (opts.Stream ? new Sequence () : readFile (opts.InPath1, Sequence::Fill1, opts.ThreadCount).release ());
+	unique_ptr <ReferenceIndex> index2;
+	if (ReferenceIndex::isIndex (opts.InPath2)) {
+		if (opts.TileSize > 0 || opts.Exclude2 || opts.Include2) {
+			cout << "--tile-size, --exclude2 and --include2 cannot be used with an index, its masks are fixed when it is built" << endl;
+			exit (2);
+		}
+		index2.reset (new ReferenceIndex (opts.InPath2));
+	}
+	unique_ptr <Sequence> gene2 (opts.TileSize > 0 ? new Sequence ()
+		: index2 ? openIndex (opts.InPath2, *index2).release ()
+		: readFile (opts.InPath2, Sequence::Fill2, opts.ThreadCount).release ());
 	printf ("All files read in %.3f s\n", elapsed (true));
-	cout << endl << endl;
+	/*
+	 * Chunks and tiles have no record table, the streamed file is checked while it is read, see ChunkStream.
+	 */
+	if ((opts.Stream && gene2->records () > 1) || (opts.TileSize > 0 && gene1->records () > 1)) {
+		cout << "--stream and --tile-size need a single record in both files, "
+		     << (opts.Stream ? opts.InPath2 : opts.InPath1) << " has several" << endl;
+		exit (2);
+	}
+	if (opts.Stream) {
+		cout << "Streaming " << opts.InPath1 << " in chunks of " << opts.StreamChunkRows << " rows" << endl;
+		if (opts.MaskNRun > 0) {
+			cout << "N masking only applies to gene 2 while streaming" << endl;
+		}
+	}
+	if (opts.TileSize > 0) {
+		cout << "Reading " << opts.InPath2 << " in tiles of " << opts.TileSize << " windows" << endl;
+		if (opts.MaskNRun > 0) {
+			cout << "N masking only applies to gene 1 with tiles" << endl;
+		}
+	}
 
-	ofstream ofs (outPath);
-	ofs << "start in " << inPath1 << ",";
-	ofs << "start in " << inPath2 << ",";
-	ofs << "score" << ",";
-	ofs << "\n";
+	/*
+	 * The reverse complement is masked the same way, with the regions mapped onto it.
+	 */
+	unique_ptr <Sequence> reverse2;
+	if (opts.BothStrands) {
+		reverse2 = gene2->reverseComplement ();
+		printf ("Reverse complement of gene 2 built in %.3f s\n", elapsed (true));
+		if (index2) {
+			cout << "The reverse strand of an index is only masked for N runs and record gaps" << endl;
+		}
+	}
+
+	unique_ptr <WindowMask> mask1 = buildMask (*gene1, opts.MaskNRun, opts.Exclude1, opts.Include1);
+	unique_ptr <WindowMask> mask2 = index2 ? index2->mask () : buildMask (*gene2, opts.MaskNRun, opts.Exclude2, opts.Include2);
+	unique_ptr <WindowMask> reverseMask2;
+	if (reverse2) {
+		reverseMask2 = index2
+			? buildMask (*reverse2, index2->maskNRun (), 0, 0)
+			: buildMask (*reverse2, opts.MaskNRun, opts.Exclude2, opts.Include2, true);
+	}
+	if (index2 && index2->maskNRun () != opts.MaskNRun) {
+		cout << "N masking of gene 2 is taken from the index (" << index2->maskNRun () << ")" << endl;
+	}
+	if (mask1 || mask2) {
+		cout << "Masked windows: "
+		     << (mask1 ? mask1->count () : 0) << " in gene 1, "
+		     << (mask2 ? mask2->count () : 0) << " in gene 2" << endl;
+	}
+
+	unique_ptr <WindowGroups> groups1;
+	unique_ptr <WindowGroups> groups2;
+	if (opts.Dedup) {
+		groups1.reset (new WindowGroups (gene1->Data, gene1->Len, opts.ThreadCount, mask1.get ()));
+		groups2 = index2 ? index2->groups () : unique_ptr <WindowGroups> ();
+		if (!groups2) {
+			groups2.reset (new WindowGroups (gene2->Data, gene2->Len, opts.ThreadCount, mask2.get ()));
+		}
+		printf ("Duplicate windows: %zu in gene 1, %zu in gene 2, grouped in %.3f s\n",
+		        groups1->Duplicates, groups2->Duplicates, elapsed (true));
+	}
+
+	/*
+	 * Masks and groups are built from the bytes, which are not needed any more once packed.
+	 */
+	unique_ptr <PackedSequence> packed1;
+	unique_ptr <PackedSequence> packed2;
+	unique_ptr <PackedSequence> reversePacked2;
+	if (opts.Packed) {
+		packed1.reset (new PackedSequence (gene1->Data, gene1->Len, gene1->Len + 50 + 32, opts.ThreadCount));
+		packed2 = index2 ? index2->packed () : unique_ptr <PackedSequence> ();
+		if (!packed2) {
+			packed2.reset (new PackedSequence (gene2->Data, gene2->Len, gene2->Len + 50 + 32, opts.ThreadCount));
+		}
+		if (reverse2) {
+			reversePacked2.reset (new PackedSequence (reverse2->Data, reverse2->Len, reverse2->Len + 50 + 32, opts.ThreadCount));
+			reverse2->release ();
+		}
+		gene1->release ();
+		gene2->release ();
+		printf ("Packed to %zu bytes in gene 1, %zu in gene 2 (%zu and %zu exception runs) in %.3f s\n",
+		        packed1->bytes (), packed2->bytes (),
+		        packed1->ExBegin.size (), packed2->ExBegin.size (), elapsed (true));
+	}
+
+	unique_ptr <ScoreMatrix> matrix;
+	if (opts.Protein) {
+		matrix.reset (new ScoreMatrix (opts.Matrix, opts.Gap));
+		cout << "Protein mode: " << matrix->Name << ", gap " << matrix->Gap
+		     << ", scores change by at most " << matrix->maxDelta () << " per position" << endl;
+	}
+
+	unique_ptr <Band> band;
+	if (opts.BandWidth >= 0) {
+		band.reset (opts.BandMapPath
+			? new Band (opts.BandMapPath, opts.BandWidth)
+			: new Band (opts.BandOffset, opts.BandWidth));
+		cout << "Banded search, width " << band->width () << endl;
+	}
+	cout << endl << endl;
 
 	cout << "Begin processing ..." << endl;
 	timeStartLoop = chrono::system_clock::now ();
 
-	Input inputs (len1, len2, gene1, gene2, threshold, nThreads, elapsed);
+	unique_ptr <ChunkStream> stream1;
+	if (opts.Stream) {
+		stream1.reset (new ChunkStream (opts.InPath1, opts.StreamChunkRows, opts.ThreadCount, Sequence::Fill1));
+	}
+	unique_ptr <ChunkStream> tiles2;
+	if (opts.TileSize > 0) {
+		tiles2.reset (new ChunkStream (opts.InPath2, opts.TileSize, opts.ThreadCount, Sequence::Fill2));
+	}
+
+	Input inputs (*gene1, *gene2, packed1.get (), packed2.get (), stream1.get (), tiles2.get (), opts, groups1.get (), groups2.get (), band.get (), mask1.get (), mask2.get (), matrix.get (), elapsed);
+	unique_ptr <Input> reverseInputs;
+	if (reverse2) {
+		reverseInputs.reset (new Input (*gene1, *reverse2, packed1.get (), reversePacked2.get (), stream1.get (), tiles2.get (), opts, 0, 0, 0, mask1.get (), reverseMask2.get (), matrix.get (), elapsed, true));
+		inputs.Reverse = reverseInputs.get ();
+	}
+	ofstream ofs (opts.OutPath, ios::binary);
+	writeResultHeader (ofs, opts, *gene1, *gene2, inputs.RecordOutput);
 	SearchMgr sm (inputs, &ofs);
 	sm.run ();
+	if (stream1) {
+		cout << "Streamed " << stream1->length () << " bases of gene 1 in " << stream1->chunks () << " chunks" << endl;
+	}
+	if (tiles2) {
+		cout << "Searched " << tiles2->length () << " bases of gene 2 in " << tiles2->chunks () << " tiles" << endl;
+	}
 
 	cout << endl << endl;
 	printf ("Processing complete, total %.3f s, iterations %.3f s)\n", elapsed (true), elapsed (false));
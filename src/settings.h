@@ -42,6 +42,19 @@
 //#define VERTICAL_SKIP_LIMIT (5)
 //#define VERTICAL_SKIP_LIMIT (1)
 
+/*
+ * VERTICAL_SKIP_LIMIT is only the default. At runtime, --skip-limit sets a fixed value or "auto".
+ * Either way the limit is capped at (threshold - 1) / 3, the largest skip a comparison can produce.
+ *
+ * In auto mode, each thread records the skip distances it observes. Every ADAPTIVE_SKIP_INTERVAL rows the limit is
+ * set to the smallest value that still covers ADAPTIVE_SKIP_COVERAGE of all positions that could be skipped
+ * vertically, i.e. rows further down that hardly ever receive skips are no longer written to.
+ */
+#define MAX_VERTICAL_SKIP_LIMIT (100/3)
+#define SKIP_LIMIT_ADAPTIVE (-1)
+#define ADAPTIVE_SKIP_INTERVAL 1024
+#define ADAPTIVE_SKIP_COVERAGE 0.95
+
 /*
  * If true, activates several integrity checks.
  * These are only for debugging and slow down the program.
@@ -71,18 +84,102 @@
  * Same as AVXset1, but the resulting maximums are calculated immediately. This allows faster calculation of the next non-skipped position.
  * Speed ~97k/s, fastest known method.
  */
+#define STRATEGY_AUTO 0
 #define STRATEGY_MEMSET 100
 #define STRATEGY_DLLIST 200
 #define STRATEGY_SLLIST 300
 #define STRATEGY_AVXSET1 400
 #define STRATEGY_AVXSET2 401
 
+/*
+ * All strategies are compiled in, this only selects the default.
+ * It can be overridden at runtime with --skipper (memset, dllist, sllist, avxset1, avxset2 or auto).
+ *
+ * auto
+ * Run every strategy on the same sample of rows, then continue with the fastest one.
+ */
+//#define LOOKUP_STRATEGY STRATEGY_AUTO
 //#define LOOKUP_STRATEGY STRATEGY_MEMSET
 //#define LOOKUP_STRATEGY STRATEGY_DLLIST
 //#define LOOKUP_STRATEGY STRATEGY_SLLIST
 //#define LOOKUP_STRATEGY STRATEGY_AVXSET1
 #define LOOKUP_STRATEGY STRATEGY_AVXSET2
 
+/*
+ * Number of rows each strategy is timed on in auto mode.
+ * The rows calculated by the winner are kept, so only the other strategies' work is lost.
+ */
+#define AUTOTUNE_ROWS 512
+
+/*
+ * Streaming mode: gene1 rows per chunk by default, and the number of chunks read ahead of the workers.
+ * Memory for gene1 is bounded by about (STREAM_QUEUE_CHUNKS + nThreads) chunks.
+ * The same read-ahead applies to gene2 tiles in tile mode.
+ */
+#define STREAM_CHUNK_ROWS (1 << 20)
+#define STREAM_QUEUE_CHUNKS 2
+
+/*
+ * Gzip input: size of the output blocks of sequential decompression, and the number of blocks (or batches of BGZF
+ * blocks) decompressed ahead of the reader.
+ */
+#define GZIP_BLOCK_BYTES (1 << 20)
+#define GZIP_QUEUE_BLOCKS 4
+
+/*
+ * Output: each search thread formats its results into blocks of this size, and at most this many blocks wait for
+ * the writer thread before the search threads are held up.
+ */
+#define RESULT_BLOCK_BYTES (1 << 16)
+#define RESULT_QUEUE_BLOCKS 64
+
+/*
+ * Ordered output: rows are handed to the threads in blocks of this many, and a thread only starts a block if fewer
+ * than this many blocks per thread are not yet written before it.
+ */
+#define ORDERED_BLOCK_ROWS (1 << 12)
+#define RESULT_REORDER_BLOCKS_PER_THREAD 4
+
+/*
+ * Region output: hits are merged if their rows are at most this far apart and their diagonals differ by at most as
+ * much. Must stay below the gap between records, so regions never span two records.
+ */
+#define REGION_GAP 8
+
+/*
+ * Protein mode: default matrix and linear gap penalty
+ */
+#define PROTEIN_MATRIX "blosum62"
+#define PROTEIN_GAP 4
+
+/*
+ * Full-length mode: scores of a match, a mismatch and the linear gap penalty. The window scoring (+2, -1, 1) rises
+ * along unrelated sequences, which is fine for 50 bases but would let alignments run on forever, these do not.
+ * Gene1 is scored in tiles of FULL_TILE_ROWS rows, each starting FULL_TILE_OVERLAP rows early so that alignments
+ * crossing the border are found in the tile they end in. Their 16 bit scores cannot overflow.
+ * Cells at or above the threshold in consecutive columns at most FULL_CHAIN_ROWS rows apart count as one alignment,
+ * and alignments are traced back until their score falls FULL_XDROP below the best one.
+ */
+#define FULL_MATCH 2
+#define FULL_MISMATCH (-3)
+#define FULL_GAP 5
+#define FULL_TILE_ROWS (1 << 12)
+#define FULL_TILE_OVERLAP (1 << 10)
+#define FULL_CHAIN_ROWS 8
+#define FULL_XDROP 100
+
+/*
+ * Dot plot mode: default and largest number of bins per side. Every thread keeps a plot of 2 bytes per bin.
+ */
+#define DOT_PLOT_SIZE 4096
+#define DOT_PLOT_MAX_SIZE (1 << 14)
+
+/*
+ * Time budget: rows are searched in blocks of this many, in an order that spreads the blocks done at any time evenly
+ * over gene1. The time is checked before every row.
+ */
+#define BUDGET_BLOCK_ROWS (1 << 12)
+
 
 // ------------------------------------------------------------------------------------------------
 
@@ -0,0 +1,59 @@
+#!/usr/bin/env python
+
+# Checks that --full-length alignments stop at the fill between records: two query records X and Z against a
+# reference ... X Y Z ..., and a query ... X Y Z ... against two reference records X and Z, must both give two
+# alignments of 300 matches, never one that runs across the fill.
+#
+#   python tests/full_length_records.py path/to/swa
+
+import csv
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+
+def bases(n):
+    return "".join(random.choice("ACGT") for _ in range(n))
+
+
+def align(swa, tmp, file1, file2):
+    """Returns the CSV rows of swa --full-length on two files given as lists of (name, bases)."""
+    paths = []
+    for k, records in enumerate((file1, file2)):
+        paths.append(os.path.join(tmp, "in%d.fa" % k))
+        with open(paths[-1], "w") as f:
+            for name, seq in records:
+                f.write(">%s\n%s\n" % (name, seq))
+    out = os.path.join(tmp, "out.csv")
+    subprocess.run([swa, paths[0], paths[1], "1", "100", out, "--full-length"], stdout=subprocess.DEVNULL)
+    with open(out) as f:
+        return [r for r in csv.reader(f)][1:]
+
+
+def check(rows, expected):
+    found = sorted((r[0], int(r[1]), int(r[2]), r[3], int(r[4]), int(r[5]), r[7]) for r in rows)
+    if found != sorted(expected):
+        sys.exit("FAIL: expected %s, got %s" % (sorted(expected), found))
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: full_length_records.py path/to/swa")
+    swa = os.path.abspath(sys.argv[1])
+    random.seed(3)
+    x, y, z = bases(300), bases(50), bases(300)
+    flankA, flankB = bases(200), bases(200)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        rows = align(swa, tmp, [("q1", x), ("q2", z)], [("ref", flankA + x + y + z + flankB)])
+        check(rows, [("q1", 0, 300, "ref", 200, 500, "300M"), ("q2", 0, 300, "ref", 550, 850, "300M")])
+
+        rows = align(swa, tmp, [("q", flankA + x + y + z + flankB)], [("r1", x), ("r2", z)])
+        check(rows, [("q", 200, 500, "r1", 0, 300, "300M"), ("q", 550, 850, "r2", 0, 300, "300M")])
+    print("OK")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,62 @@
+#!/usr/bin/env python
+
+# Checks that --lanes only changes how windows are scored, not the results: a query against a copy of itself with
+# substitutions, insertions and deletions must give the same rows with and without it.
+#
+#   python tests/lanes_results.py path/to/swa
+
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+
+def mutate(seq):
+    out = []
+    for c in seq:
+        r = random.random()
+        if r < 0.1:
+            out.append(random.choice("ACGT"))
+        elif r < 0.15:
+            pass
+        elif r < 0.2:
+            out.append(c + random.choice("ACGT"))
+        else:
+            out.append(c)
+    return "".join(out)
+
+
+def rows(swa, tmp, extra):
+    out = os.path.join(tmp, "out.csv")
+    subprocess.run([swa, os.path.join(tmp, "in1.fa"), os.path.join(tmp, "in2.fa"), "1", "45", out] + extra,
+                   stdout=subprocess.DEVNULL)
+    with open(out) as f:
+        return sorted(f.readlines()[1:])
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: lanes_results.py path/to/swa")
+    swa = os.path.abspath(sys.argv[1])
+    random.seed(11)
+    query = "".join(random.choice("AACGTT") for _ in range(1500))
+
+    with tempfile.TemporaryDirectory() as tmp:
+        with open(os.path.join(tmp, "in1.fa"), "w") as f:
+            f.write(">a\n%s\n" % query)
+        with open(os.path.join(tmp, "in2.fa"), "w") as f:
+            f.write(">b\n%s\n" % mutate(query))
+        regular = rows(swa, tmp, [])
+        lanes = rows(swa, tmp, ["--lanes"])
+
+    if not regular:
+        sys.exit("FAIL: no results")
+    if regular != lanes:
+        diff = len(set(regular) ^ set(lanes))
+        sys.exit("FAIL: %d of %d rows differ with --lanes" % (diff, len(regular)))
+    print("OK: %d rows" % len(regular))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,67 @@
+#!/usr/bin/env python
+
+# Checks that --packed keeps soft masked (lower case) bases apart from upper case ones, like the unpacked search
+# does, while they are packed with their case in a bitmap rather than kept as exceptions.
+#
+#   python tests/packed_case.py path/to/swa
+
+import os
+import random
+import re
+import subprocess
+import sys
+import tempfile
+
+
+def softMask(seq):
+    out = list(seq)
+    k = 0
+    while k < len(out):
+        if random.random() < 0.01:
+            n = random.randint(5, 300)
+            out[k:k + n] = [c.lower() for c in out[k:k + n]]
+            k += n
+        k += 1
+    return "".join(out)
+
+
+def mutate(seq):
+    return "".join(c if random.random() < 0.85 else random.choice("ACGTN") for c in seq)
+
+
+def run(swa, tmp, extra):
+    out = os.path.join(tmp, "out.csv")
+    log = subprocess.run([swa, os.path.join(tmp, "in1.fa"), os.path.join(tmp, "in2.fa"), "1", "60", out] + extra,
+                         stdout=subprocess.PIPE, universal_newlines=True).stdout
+    with open(out) as f:
+        return sorted(f.readlines()[1:]), log
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: packed_case.py path/to/swa")
+    swa = os.path.abspath(sys.argv[1])
+    random.seed(21)
+    query = "".join(random.choice("ACGT") for _ in range(20000))
+
+    with tempfile.TemporaryDirectory() as tmp:
+        with open(os.path.join(tmp, "in1.fa"), "w") as f:
+            f.write(">a\n%s\n" % softMask(query))
+        with open(os.path.join(tmp, "in2.fa"), "w") as f:
+            f.write(">b\n%s\n" % softMask(mutate(query[3000:15000])))
+        regular, _ = run(swa, tmp, [])
+        packed, log = run(swa, tmp, ["--packed"])
+
+    if not regular:
+        sys.exit("FAIL: no results")
+    if regular != packed:
+        sys.exit("FAIL: %d of %d rows differ with --packed" % (len(set(regular) ^ set(packed)), len(regular)))
+    # only the fill after the end of gene 1 is left as an exception
+    runs = re.search(r"\((\d+) and \d+ exception runs\)", log)
+    if not runs or runs.group(1) != "1":
+        sys.exit("FAIL: lower case bases are still exceptions:\n%s" % log)
+    print("OK: %d rows" % len(regular))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,58 @@
+#!/usr/bin/env python
+
+# Checks that --stream and --tile-size refuse files with several records, whose chunks and tiles would mix the
+# coordinates of the records, whether the file is streamed, tiled or loaded, and when file 1 comes from stdin.
+#
+#   python tests/stream_records.py path/to/swa
+
+import os
+import random
+import subprocess
+import sys
+import tempfile
+
+
+def bases(n):
+    return "".join(random.choice("ACGT") for _ in range(n))
+
+
+def run(swa, args, stdin=None):
+    result = subprocess.run([swa] + args, stdin=stdin, stdout=subprocess.PIPE, universal_newlines=True)
+    return result.returncode, result.stdout
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: stream_records.py path/to/swa")
+    swa = os.path.abspath(sys.argv[1])
+    random.seed(5)
+
+    with tempfile.TemporaryDirectory() as tmp:
+        one = os.path.join(tmp, "one.fa")
+        two = os.path.join(tmp, "two.fa")
+        with open(one, "w") as f:
+            f.write(">a\n%s\n" % bases(2000))
+        with open(two, "w") as f:
+            f.write(">b1\n%s\n>b2\n%s\n" % (bases(1000), bases(1000)))
+        out = os.path.join(tmp, "out.csv")
+
+        for args in ([two, one, "1", "70", out, "--stream"],
+                     [one, two, "1", "70", out, "--stream"],
+                     [one, two, "1", "70", out, "--tile-size", "500"],
+                     [two, one, "1", "70", out, "--tile-size", "500"]):
+            code, log = run(swa, args)
+            if code != 2 or "need a single record" not in log:
+                sys.exit("FAIL: %s was not refused:\n%s" % (" ".join(args[4:]), log))
+        with open(two) as f:
+            code, log = run(swa, ["-", one, "1", "70", out], stdin=f)
+        if code != 2 or "need a single record" not in log:
+            sys.exit("FAIL: several records on stdin were not refused:\n%s" % log)
+
+        code, log = run(swa, [one, one, "1", "70", out, "--tile-size", "500"])
+        if "Result hash" not in log:
+            sys.exit("FAIL: a single record was refused:\n%s" % log)
+    print("OK")
+
+
+if __name__ == "__main__":
+    main()
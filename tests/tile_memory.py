@@ -0,0 +1,63 @@
+#!/usr/bin/env python
+
+# Checks that --tile-size keeps memory bounded by the tile size: more threads must not add memory in proportion to
+# file 2, which is what a search per thread and tile used to do.
+#
+#   python tests/tile_memory.py path/to/swa
+
+import os
+import random
+import sys
+import tempfile
+
+REFERENCE = 4000000
+TILE = 20000
+
+# every thread may keep a few tiles worth of skips and buffers, a search per tile grew by REFERENCE per thread
+ALLOWED_GROWTH = 8 << 20
+
+
+def peakRss(args, log):
+    """Runs args in a child process with its output in log and returns its peak resident set size in bytes."""
+    pid = os.fork()
+    if pid == 0:
+        fd = os.open(log, os.O_WRONLY | os.O_CREAT | os.O_TRUNC)
+        os.dup2(fd, 1)
+        os.execv(args[0], args)
+    _, _, usage = os.wait4(pid, 0)
+    with open(log) as f:
+        output = f.read()
+    if "Result hash" not in output:
+        sys.exit("%s did not finish:\n%s" % (" ".join(args), output))
+    return usage.ru_maxrss * 1024
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit("usage: tile_memory.py path/to/swa")
+    swa = os.path.abspath(sys.argv[1])
+    random.seed(1)
+    with tempfile.TemporaryDirectory() as tmp:
+        reference = "".join(random.choice("ACGT") for _ in range(REFERENCE))
+        with open(os.path.join(tmp, "ref.fa"), "w") as f:
+            f.write(">ref\n")
+            for k in range(0, len(reference), 80):
+                f.write(reference[k:k + 80] + "\n")
+        with open(os.path.join(tmp, "query.fa"), "w") as f:
+            f.write(">query\n" + reference[1000000:1000100] + "\n")
+
+        rss = {}
+        for threads in (1, 8):
+            rss[threads] = peakRss([swa, os.path.join(tmp, "query.fa"), os.path.join(tmp, "ref.fa"), str(threads), "60",
+                                    os.path.join(tmp, "out.csv"), "--tile-size", str(TILE)], os.path.join(tmp, "log.txt"))
+            print("%d threads: peak RSS %.1f MB" % (threads, rss[threads] / 1e6))
+
+    growth = rss[8] - rss[1]
+    if growth > ALLOWED_GROWTH:
+        sys.exit("FAIL: 8 threads use %.1f MB more than 1, at most %.1f MB allowed"
+                 % (growth / 1e6, ALLOWED_GROWTH / 1e6))
+    print("OK")
+
+
+if __name__ == "__main__":
+    main()